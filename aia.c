@@ -0,0 +1,174 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "libstr.h"
+#include "trap.h"
+#include "fdt.h"
+#include "cpu.h"
+#include "irq.h"
+#include "aia.h"
+
+//--------------------------------------------------
+//                APLIC (S-LEVEL DOMAIN)
+//--------------------------------------------------
+// The APLIC latches wired sources and, in MSI delivery mode, forwards
+// each one as a write of its EIID to the target hart's IMSIC. The MSI
+// address configuration belongs to the M-level domain (set by firmware),
+// so the kernel only programs sources, targets and enables.
+
+#define APLIC_COMPAT    "riscv,aplic"
+#define IMSIC_COMPAT    "riscv,imsics"
+
+#define APLIC_DOMAINCFG         0x0000
+#define APLIC_SOURCECFG(irq)    (0x0004 + 4 * ((irq) - 1))
+#define APLIC_SETIENUM          0x1edc
+#define APLIC_CLRIENUM          0x1fdc
+#define APLIC_SETIPNUM_LE       0x2000
+#define APLIC_TARGET(irq)       (0x3004 + 4 * ((irq) - 1))
+
+#define DOMAINCFG_IE            (1U << 8)   // Interrupt enable
+#define DOMAINCFG_DM            (1U << 2)   // Delivery mode: MSI
+#define SOURCECFG_LEVEL_HIGH    6
+#define TARGET_HART_SHIFT       18
+
+static uint64_t aplic_base;
+
+static inline volatile uint32_t *aplic_reg(uint64_t off) {
+    return (volatile uint32_t *)(aplic_base + off);
+}
+
+//--------------------------------------------------
+//                 IMSIC (PER HART)
+//--------------------------------------------------
+// Each hart's S-level interrupt file is reached through the indirect
+// CSRs: siselect picks a register, sireg reads/writes it. stopei returns
+// the highest pending, enabled identity and clears it when written.
+
+#define CSR_SISELECT    "0x150"
+#define CSR_SIREG       "0x151"
+#define CSR_STOPEI      "0x15c"
+
+#define IMSIC_EIDELIVERY    0x70
+#define IMSIC_EITHRESHOLD   0x72
+#define IMSIC_EIE0          0xc0    // RV64: only even eieN, 64 ids each
+
+static unsigned int imsic_nr_ids = 63;
+
+static void imsic_write(uint64_t sel, uint64_t value) {
+    asm volatile("csrw " CSR_SISELECT ", %0\n"
+                 "csrw " CSR_SIREG ", %1" :: "r"(sel), "r"(value) : "memory");
+}
+
+static void aia_init_hart(void) {
+    imsic_write(IMSIC_EIDELIVERY, 1);
+    imsic_write(IMSIC_EITHRESHOLD, 0);      // No threshold
+
+    // Identity map IRQ n -> EIID n and accept every id on every hart;
+    // routing is decided solely by the APLIC target registers
+    unsigned int last = (IRQ_MAX - 1 < imsic_nr_ids) ? IRQ_MAX - 1 : imsic_nr_ids;
+    for (unsigned int id = 1; id <= last; id++) {
+        uint64_t sel = IMSIC_EIE0 + 2 * (id / 64);
+        asm volatile("csrw " CSR_SISELECT ", %0\n"
+                     "csrs " CSR_SIREG ", %1" :: "r"(sel), "r"(1UL << (id % 64)) : "memory");
+    }
+}
+
+static unsigned int aia_claim(void) {
+    uint64_t top;
+    asm volatile("csrrw %0, " CSR_STOPEI ", zero" : "=r"(top) :: "memory");
+    return top >> 16;
+}
+
+// An MSI is a one-shot edge: if the level-triggered source is still
+// asserted after handling, have the APLIC re-pend it (ignored otherwise)
+static void aia_complete(unsigned int irq) {
+    *aplic_reg(APLIC_SETIPNUM_LE) = irq;
+}
+
+static void aia_setup(unsigned int irq) {
+    *aplic_reg(APLIC_SOURCECFG(irq)) = SOURCECFG_LEVEL_HIGH;
+}
+
+// An MSI has a single destination: route to the lowest hart in the mask
+static uint64_t aia_set_affinity(unsigned int irq, uint64_t old, uint64_t mask) {
+    (void)old;
+    unsigned int i = 0;
+    while (!(mask & (1UL << i))) i++;
+
+    *aplic_reg(APLIC_TARGET(irq)) = (uint32_t)(cpus[i].hartid << TARGET_HART_SHIFT) | irq;
+    *aplic_reg(APLIC_SETIENUM) = irq;
+    return 1UL << i;
+}
+
+const struct irq_chip aia_chip = {
+    .name = "AIA (APLIC -> IMSIC MSIs)",
+    .init_hart = aia_init_hart,
+    .setup = aia_setup,
+    .set_affinity = aia_set_affinity,
+    .claim = aia_claim,
+    .complete = aia_complete,
+};
+
+//--------------------------------------------------
+//                     PROBE
+//--------------------------------------------------
+
+// The device tree may also list the M-level APLIC and IMSIC, unless
+// firmware disabled them: the ones the kernel wants are the IMSIC that
+// raises supervisor external interrupts and the APLIC whose msi-parent
+// is that IMSIC.
+
+static int node_okay(int node) {
+    const char *status = fdt_node_prop(node, "status", NULL);
+    return !status || strcmp(status, "okay") == 0 || strcmp(status, "ok") == 0;
+}
+
+static uint32_t node_phandle(int node) {
+    int len;
+    const void *ph = fdt_node_prop(node, "phandle", &len);
+    return ph && len == 4 ? fdt_read_cells(ph, len) : 0;
+}
+
+static int imsic_find(void) {
+    for (int n = fdt_find_compatible(-1, IMSIC_COMPAT); n >= 0;
+         n = fdt_find_compatible(n, IMSIC_COMPAT)) {
+        int len;
+        // <cpu-intc phandle, cause> per hart; all entries name one level
+        const uint8_t *irqs = fdt_node_prop(n, "interrupts-extended", &len);
+        if (node_okay(n) && irqs && len >= 8 && fdt_read_cells(irqs + 4, 4) == IRQ_S_EXT)
+            return n;
+    }
+    return -1;
+}
+
+static int aplic_find(uint32_t imsic_phandle) {
+    for (int n = fdt_find_compatible(-1, APLIC_COMPAT); n >= 0;
+         n = fdt_find_compatible(n, APLIC_COMPAT)) {
+        int len;
+        const void *parent = fdt_node_prop(n, "msi-parent", &len);
+        if (node_okay(n) && parent && len == 4 && fdt_read_cells(parent, len) == imsic_phandle)
+            return n;
+    }
+    return -1;
+}
+
+int aia_probe(void) {
+    int len;
+    int imsic = imsic_find();
+    uint32_t phandle = imsic >= 0 ? node_phandle(imsic) : 0;
+    int aplic = phandle ? aplic_find(phandle) : -1;
+    const void *reg = fdt_node_prop(aplic, "reg", &len);
+    if (!reg || len < 8) return 0;
+
+    // The device tree may describe AIA on a hart without Ssaia CSRs
+    uint64_t v;
+    trap_probe_begin();
+    asm volatile("csrr %0, " CSR_SISELECT : "=r"(v) :: "memory");
+    if (trap_probe_end()) return 0;
+
+    const void *ids = fdt_node_prop(imsic, "riscv,num-ids", &len);
+    if (ids) imsic_nr_ids = fdt_read_cells(ids, len);
+
+    aplic_base = fdt_read_cells(reg, 8);
+    *aplic_reg(APLIC_DOMAINCFG) = DOMAINCFG_IE | DOMAINCFG_DM;
+    return 1;
+}
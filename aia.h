@@ -0,0 +1,17 @@
+#ifndef AIA_H
+#define AIA_H
+
+#include "stdint.h"
+#include "irq.h"
+
+// Advanced Interrupt Architecture (QEMU virt with aia=aplic-imsic): the
+// S-level APLIC turns wired interrupts into MSIs written straight into
+// each hart's IMSIC interrupt file
+
+// Returns 1 (and switches the APLIC to MSI delivery) if the device tree
+// describes an S-level APLIC + IMSIC and the hart implements Ssaia
+int aia_probe(void);
+
+extern const struct irq_chip aia_chip;
+
+#endif
@@ -0,0 +1,245 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+#include "lock.h"
+#include "clock.h"
+#include "timer.h"
+#include "thread.h"
+#include "wait.h"
+#include "cpu.h"
+#include "io.h"
+#include "async.h"
+
+//--------------------------------------------------
+//                  TASK POOL
+//--------------------------------------------------
+// Tasks cost sizeof(struct async_task) each, with no stack of their
+// own. A single executor thread runs ready tasks to their next
+// suspension point; events and timers put them back on the ready queue
+// from any hart or interrupt and wake the executor.
+
+static struct async_task task_pool[ASYNC_MAX_TASKS];
+static struct async_task *free_list;
+static struct async_task *ready_head;
+static struct async_task *ready_tail;
+// Pool and ready queue: signalled from timers and events on every hart
+static struct lock_stats async_lock_stats = LOCK_STATS_INIT("async");
+static mcs_lock_t async_lock = MCS_LOCK_INIT_STATS(&async_lock_stats);
+static struct waitqueue executor_wait = WAITQUEUE_INIT;
+static unsigned int tasks_live;
+
+// Caller holds async_lock
+static void ready_push(struct async_task *t) {
+    t->next = NULL;
+    if (ready_tail) ready_tail->next = t;
+    else ready_head = t;
+    ready_tail = t;
+}
+
+static void make_ready(struct async_task *t) {
+    struct mcs_node n;
+    uint64_t s = mcs_lock_irqsave(&async_lock, &n);
+    ready_push(t);
+    mcs_unlock_irqrestore(&async_lock, &n, s);
+    wake_one(&executor_wait);
+}
+
+struct async_task *async_spawn(async_fn_t fn, void *arg) {
+    struct mcs_node n;
+    uint64_t s = mcs_lock_irqsave(&async_lock, &n);
+    struct async_task *t = free_list;
+    if (t) {
+        free_list = t->next;
+        tasks_live++;
+        t->fn = fn;
+        t->arg = arg;
+        t->resume = 0;
+        ready_push(t);
+    }
+    mcs_unlock_irqrestore(&async_lock, &n, s);
+    if (t) wake_one(&executor_wait);
+    return t;
+}
+
+//--------------------------------------------------
+//                EVENTS AND SLEEP
+//--------------------------------------------------
+
+void async_event_init(struct async_event *ev) {
+    ev->lock = (spinlock_t)SPINLOCK_INIT;
+    ev->count = 0;
+    ev->waiters = NULL;
+    waitqueue_init(&ev->wait);
+}
+
+void async_event_signal(struct async_event *ev) {
+    uint64_t s = spin_lock_irqsave(&ev->lock);
+    struct async_task *t = ev->waiters;
+    if (t) ev->waiters = t->next;
+    else ev->count++;
+    spin_unlock_irqrestore(&ev->lock, s);
+
+    if (t) make_ready(t);
+    else wake_one(&ev->wait);
+}
+
+// Consume a pending signal, or park t on the event (returns 0)
+int async_event_take(struct async_event *ev, struct async_task *t) {
+    uint64_t s = spin_lock_irqsave(&ev->lock);
+    int got = ev->count > 0;
+    if (got) {
+        ev->count--;
+    } else {
+        t->next = ev->waiters;
+        ev->waiters = t;
+    }
+    spin_unlock_irqrestore(&ev->lock, s);
+    return got;
+}
+
+void async_event_wait(struct async_event *ev) {
+    for (;;) {
+        uint64_t s = spin_lock_irqsave(&ev->lock);
+        if (ev->count > 0) {
+            ev->count--;
+            spin_unlock_irqrestore(&ev->lock, s);
+            return;
+        }
+        spin_unlock_irqrestore(&ev->lock, s);
+        wait_event(&ev->wait, ev->count > 0);
+    }
+}
+
+static void sleep_expired(struct timer *tm, void *arg) {
+    (void)tm;
+    make_ready(arg);
+}
+
+void async_sleep(struct async_task *t, uint64_t ms) {
+    timer_setup(&t->timer, sleep_expired, t);
+    timer_start(&t->timer, ms);
+}
+
+//--------------------------------------------------
+//                   EXECUTOR
+//--------------------------------------------------
+
+static int executor_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        struct mcs_node n;
+        // Woken by make_ready / async_spawn
+        wait_event(&executor_wait, ready_head != NULL);
+        uint64_t s = mcs_lock_irqsave(&async_lock, &n);
+        struct async_task *t = ready_head;
+        if (!t) {
+            mcs_unlock_irqrestore(&async_lock, &n, s);
+            continue;
+        }
+        ready_head = t->next;
+        if (!ready_head) ready_tail = NULL;
+        mcs_unlock_irqrestore(&async_lock, &n, s);
+
+        int ret = t->fn(t);
+
+        // BLOCKED: t already belongs to an event or timer, leave it alone
+        if (ret == ASYNC_READY) {
+            make_ready(t);
+        } else if (ret == ASYNC_DONE) {
+            s = mcs_lock_irqsave(&async_lock, &n);
+            t->next = free_list;
+            free_list = t;
+            tasks_live--;
+            mcs_unlock_irqrestore(&async_lock, &n, s);
+        }
+    }
+    return 0;
+}
+
+void async_init(void) {
+    lock_stats_register(&async_lock_stats);
+    for (int i = ASYNC_MAX_TASKS - 1; i >= 0; i--) {
+        task_pool[i].next = free_list;
+        free_list = &task_pool[i];
+    }
+    int tid = thread_create("async", executor_main, NULL);
+    if (tid < 0) {
+        uart_puts("async: no thread for the executor\n");
+        return;
+    }
+    thread_detach(tid);
+}
+
+//--------------------------------------------------
+//                    DEMO
+//--------------------------------------------------
+
+struct demo {
+    struct async_event done;    // Signalled by the last task to finish
+    volatile uint32_t left;
+};
+
+// One run at a time: the tasks find demo through this static
+static struct demo demo;
+static struct mutex demo_lock = MUTEX_INIT;
+
+static unsigned int tasks_free(void) {
+    struct mcs_node n;
+    uint64_t s = mcs_lock_irqsave(&async_lock, &n);
+    unsigned int free = ASYNC_MAX_TASKS - tasks_live;
+    mcs_unlock_irqrestore(&async_lock, &n, s);
+    return free;
+}
+
+static int demo_task(struct async_task *t) {
+    ASYNC_BEGIN(t);
+    // Stagger the wake-ups: 1..50 ms, keyed off the task's pool slot
+    ASYNC_SLEEP(t, 1 + (uint64_t)(t - task_pool) % 50);
+    ASYNC_YIELD(t);
+    if (atomic_fetch_add32(&demo.left, (uint32_t)-1) == 1)
+        async_event_signal(&demo.done);
+    ASYNC_END(t);
+}
+
+void async_demo(unsigned int n) {
+    if (!mutex_trylock(&demo_lock)) {
+        uart_puts("asyncdemo: another demo is running\n");
+        return;
+    }
+    unsigned int free = tasks_free();
+    if (n == 0 || n > free) {
+        uart_puts("asyncdemo: task pool has room for ");
+        uart_putdec(free);
+        uart_puts(" tasks\n");
+        mutex_unlock(&demo_lock);
+        return;
+    }
+    async_event_init(&demo.done);
+    demo.left = n;
+
+    // Other spawners may take slots meanwhile: take the tasks that never
+    // started off the count, and signal here if the rest already finished
+    uint64_t start = clock_now();
+    unsigned int started = 0;
+    while (started < n && async_spawn(demo_task, NULL)) started++;
+    unsigned int missing = n - started;
+    if (missing && atomic_fetch_add32(&demo.left, -missing) == missing)
+        async_event_signal(&demo.done);
+    async_event_wait(&demo.done);
+    uint64_t elapsed = clock_now() - start;
+    mutex_unlock(&demo_lock);
+
+    if (missing) {
+        uart_puts("asyncdemo: pool ran out, started ");
+        uart_putdec(started);
+        uart_puts(" of ");
+        uart_putdec(n);
+        uart_puts(" tasks\n");
+    }
+    uart_putdec(started);
+    uart_puts(" tasks (");
+    uart_putdec(sizeof(struct async_task));
+    uart_puts(" bytes each) slept and finished in ");
+    uart_putdec(clock_to_ms(elapsed));
+    uart_puts(" ms\n");
+}
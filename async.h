@@ -0,0 +1,99 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include "stdint.h"
+#include "lock.h"
+#include "wait.h"
+#include "timer.h"
+
+//--------------------------------------------------
+//              STACKLESS ASYNC TASKS
+//--------------------------------------------------
+// A task is a function re-entered from the top each time it runs; the
+// ASYNC_* macros jump back to where it last suspended (a switch on the
+// saved line number, as in protothreads). Nothing on the C stack
+// survives a suspension: keep state in the object passed as arg.
+// Do not use a switch statement around a suspension point.
+//
+//   static int reader(struct async_task *t) {
+//       struct req *r = t->arg;
+//       ASYNC_BEGIN(t);
+//       while (r->left--) {
+//           ASYNC_AWAIT(t, &r->done);
+//           ASYNC_SLEEP(t, 10);
+//       }
+//       ASYNC_END(t);
+//   }
+
+#define ASYNC_MAX_TASKS 1024
+
+// Return values of a task function
+#define ASYNC_DONE      0       // Finished: the task is freed
+#define ASYNC_READY     1       // Yielded: run again soon
+#define ASYNC_BLOCKED   2       // Parked on an event or timer
+
+struct async_task;
+typedef int (*async_fn_t)(struct async_task *t);
+
+struct async_task {
+    struct async_task *next;    // Ready queue / event wait list / free list
+    async_fn_t fn;
+    void *arg;
+    unsigned int resume;        // Line to continue from, 0 = start
+    struct timer timer;         // ASYNC_SLEEP
+};
+
+// Counting event: each signal releases one waiter, or is remembered
+// for the next wait if nobody is waiting. Safe to signal from interrupts.
+struct async_event {
+    spinlock_t lock;
+    unsigned int count;
+    struct async_task *waiters;
+    struct waitqueue wait;      // Threads blocked in async_event_wait
+};
+
+#define ASYNC_BEGIN(t)  switch ((t)->resume) { case 0:
+
+#define ASYNC_END(t)    } (t)->resume = 0; return ASYNC_DONE
+
+#define ASYNC_YIELD(t)                                      \
+    do {                                                    \
+        (t)->resume = __LINE__; return ASYNC_READY;         \
+        case __LINE__:;                                     \
+    } while (0)
+
+#define ASYNC_AWAIT(t, ev)                                  \
+    do {                                                    \
+        (t)->resume = __LINE__;                             \
+        if (!async_event_take((ev), (t))) return ASYNC_BLOCKED; \
+        __attribute__((fallthrough));                       \
+        case __LINE__:;                                     \
+    } while (0)
+
+#define ASYNC_SLEEP(t, ms)                                  \
+    do {                                                    \
+        (t)->resume = __LINE__;                             \
+        async_sleep((t), (ms)); return ASYNC_BLOCKED;       \
+        case __LINE__:;                                     \
+    } while (0)
+
+// Start the executor thread
+void async_init(void);
+
+// Queue fn(t) with t->arg = arg; NULL if the pool is exhausted
+struct async_task *async_spawn(async_fn_t fn, void *arg);
+
+void async_event_init(struct async_event *ev);
+void async_event_signal(struct async_event *ev);
+
+// From a thread: block until the event is signalled, then consume it
+void async_event_wait(struct async_event *ev);
+
+// Used by the macros
+int async_event_take(struct async_event *ev, struct async_task *t);
+void async_sleep(struct async_task *t, uint64_t ms);
+
+// asyncdemo command: n concurrent sleeping tasks
+void async_demo(unsigned int n);
+
+#endif
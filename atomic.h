@@ -0,0 +1,79 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include "stdint.h"
+
+//--------------------------------------------------
+//            RISC-V "A" EXTENSION ATOMICS
+//--------------------------------------------------
+// Thin wrappers over AMOs and LR/SC. All operations are fully ordered
+// (.aqrl) and return the value that was in memory before the update.
+
+static inline uint32_t atomic_swap32(volatile uint32_t *p, uint32_t v) {
+    uint32_t old;
+    asm volatile("amoswap.w.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_swap64(volatile uint64_t *p, uint64_t v) {
+    uint64_t old;
+    asm volatile("amoswap.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+    return old;
+}
+
+static inline uint32_t atomic_fetch_add32(volatile uint32_t *p, uint32_t v) {
+    uint32_t old;
+    asm volatile("amoadd.w.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_fetch_add64(volatile uint64_t *p, uint64_t v) {
+    uint64_t old;
+    asm volatile("amoadd.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_fetch_or64(volatile uint64_t *p, uint64_t v) {
+    uint64_t old;
+    asm volatile("amoor.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_fetch_and64(volatile uint64_t *p, uint64_t v) {
+    uint64_t old;
+    asm volatile("amoand.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+    return old;
+}
+
+// Compare-and-swap: store v if *p == expect; returns the old value
+static inline uint64_t atomic_cmpxchg64(volatile uint64_t *p, uint64_t expect, uint64_t v) {
+    uint64_t old;
+    uint64_t fail;
+    asm volatile(
+        "1: lr.d.aqrl %0, %2\n"
+        "   bne %0, %3, 2f\n"
+        "   sc.d.rl %1, %4, %2\n"
+        "   bnez %1, 1b\n"
+        "2:\n"
+        : "=&r"(old), "=&r"(fail), "+A"(*p)
+        : "r"(expect), "r"(v)
+        : "memory");
+    return old;
+}
+
+static inline uint32_t atomic_cmpxchg32(volatile uint32_t *p, uint32_t expect, uint32_t v) {
+    uint32_t old;
+    uint32_t fail;
+    asm volatile(
+        "1: lr.w.aqrl %0, %2\n"
+        "   bne %0, %3, 2f\n"
+        "   sc.w.rl %1, %4, %2\n"
+        "   bnez %1, 1b\n"
+        "2:\n"
+        : "=&r"(old), "=&r"(fail), "+A"(*p)
+        : "r"((uint64_t)(int32_t)expect), "r"(v)
+        : "memory");
+    return old;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "fdt.h"
+#include "clock.h"
+
+//--------------------------------------------------
+//                  CLOCKSOURCE
+//--------------------------------------------------
+// The `time` CSR ticks at the timebase frequency advertised in the
+// device tree (/cpus/timebase-frequency). QEMU virt uses 10 MHz, which
+// is also the fallback when the property is missing.
+
+static uint64_t timebase_hz = 10000000;
+static uint64_t boot_time = 0;
+
+void clock_init(void) {
+    int len;
+    const void *prop = fdt_get_prop("/cpus", "timebase-frequency", &len);
+    if (prop && (len == 4 || len == 8)) {
+        uint64_t hz = fdt_read_cells(prop, len);
+        if (hz >= 1000000) timebase_hz = hz;   // Conversions assume >= 1 MHz
+    }
+    boot_time = rdtime();
+}
+
+uint64_t clock_now(void) {
+    return rdtime();
+}
+
+uint64_t clock_hz(void) {
+    return timebase_hz;
+}
+
+// Split into whole seconds and remainder so t * 1e9 cannot overflow
+uint64_t clock_to_ns(uint64_t t) {
+    uint64_t sec = t / timebase_hz;
+    uint64_t rem = t % timebase_hz;
+    return sec * 1000000000UL + rem * 1000000000UL / timebase_hz;
+}
+
+// Same split: the timebase need not be a multiple of 1 MHz (or 1 kHz)
+uint64_t clock_to_us(uint64_t t) {
+    return t / timebase_hz * 1000000UL + (t % timebase_hz) * 1000000UL / timebase_hz;
+}
+
+uint64_t clock_to_ms(uint64_t t) {
+    return t / timebase_hz * 1000UL + (t % timebase_hz) * 1000UL / timebase_hz;
+}
+
+uint64_t clock_uptime_ns(void) {
+    return clock_to_ns(rdtime() - boot_time);
+}
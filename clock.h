@@ -0,0 +1,21 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "stdint.h"
+
+// Read the timebase frequency from the device tree (call after fdt_init)
+void clock_init(void);
+
+// Raw clocksource: the `time` CSR, counting at the platform timebase
+uint64_t clock_now(void);
+uint64_t clock_hz(void);
+
+// Conversions from raw clock ticks
+uint64_t clock_to_ns(uint64_t t);
+uint64_t clock_to_us(uint64_t t);
+uint64_t clock_to_ms(uint64_t t);
+
+// Time since boot
+uint64_t clock_uptime_ns(void);
+
+#endif
@@ -13,6 +13,23 @@ void cmd_help(void) {
     uart_puts("  help              - Show this help message\n");
     uart_puts("  echo <text>       - Echo text back\n");
     uart_puts("  exit              - Shutdown the system\n");
+    uart_puts("  sleep <ms>        - Pause the shell for <ms> milliseconds\n");
+    uart_puts("  timerbench        - Compare SBI vs Sstc timer re-arm cost\n");
+    uart_puts("  cpustat           - Show per-hart busy/idle time\n");
+    uart_puts("  uptime            - Time since boot\n");
+    uart_puts("  threads           - List kernel threads\n");
+    uart_puts("  top [ms]          - Live per-hart and per-task CPU use (any key quits)\n");
+    uart_puts("  timeslice [ms]    - Show/set the preemption timeslice\n");
+    uart_puts("  nice <n> <cmd>    - Run a command at nice n (-20..19)\n");
+    uart_puts("  chrt [opts] <tid> - Show/set class: -f <prio>, -o, -d <rt> <dl> <period>\n");
+    uart_puts("  asyncdemo [n]     - Run n sleeping stackless tasks (default 1000)\n");
+    uart_puts("  switchbench       - Measure thread context switch cost\n");
+    uart_puts("  ringbench [n]     - Lock-free SPSC/MPSC ring throughput between harts\n");
+    uart_puts("  irqs              - Per-hart interrupt counts and affinity\n");
+    uart_puts("  irqaff <irq> [m]  - Show/set IRQ hart mask (e.g. 0x2 = 2nd hart)\n");
+    uart_puts("  lockstat [reset]  - Show/clear per-lock contention statistics\n");
+    uart_puts("  latency [reset]   - Show/clear interrupt and wakeup latency histograms\n");
+    uart_puts("  time <command>    - Run a command, report time/cycles/instret\n");
     uart_puts("\n--- File Operations ---\n");
     uart_puts("  touch <name>      - Create file (default: rw permissions)\n");
     uart_puts("  touchro <name>    - Create read-only file\n");
@@ -31,6 +48,11 @@ void cmd_help(void) {
     uart_puts("  stat <path>       - Show file/dir info\n");
     uart_puts("\n--- Program Execution ---\n");
     uart_puts("  exec <file>       - Run commands from a script file\n");
+    uart_puts("  parallel <s>...   - Run scripts side by side across harts, with timings\n");
+    uart_puts("  <command> &       - Run a command in the background as a job\n");
+    uart_puts("  jobs              - List background jobs\n");
+    uart_puts("  wait [job]        - Wait for a job (or all) and show exit status\n");
+    uart_puts("  kill <job>        - Stop a job at its next command or sleep\n");
     uart_puts("  Scripts need execute permission (chmod file 5)\n");
     uart_puts("  Commands separated by newlines or semicolons\n");
     uart_puts("  Lines starting with # are comments\n");
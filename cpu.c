@@ -0,0 +1,105 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "clock.h"
+#include "io.h"
+#include "softirq.h"
+#include "thread.h"
+#include "cpu.h"
+
+//--------------------------------------------------
+//               PER-HART STATE
+//--------------------------------------------------
+
+struct cpu cpus[MAX_HARTS];
+
+// Bind the calling hart to its cpus[] slot via tp
+void cpu_init(unsigned int id, uint64_t hartid) {
+    struct cpu *c = &cpus[id];
+    c->hartid = hartid;
+    c->id = id;
+    c->online_since = clock_now();
+    asm volatile("mv tp, %0" :: "r"(c));
+}
+
+// Last step of a hart's bring-up, once its trap vector, IRQs, IPIs and
+// timer are set up: from here on it is a target for IRQ affinity,
+// pinned threads and IPIs
+void cpu_set_online(void) {
+    mb();                       // Publish the per-hart state first
+    this_cpu()->online = 1;
+}
+
+uint64_t cpu_online_mask(void) {
+    uint64_t mask = 0;
+    for (unsigned int i = 0; i < MAX_HARTS; i++)
+        if (cpus[i].online) mask |= 1UL << i;
+    return mask;
+}
+
+unsigned int cpu_count(void) {
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < MAX_HARTS; i++)
+        if (cpus[i].online) n++;
+    return n;
+}
+
+//--------------------------------------------------
+//                  IDLE LOOP
+//--------------------------------------------------
+// There is no periodic tick: an idle hart stays in wfi until a device
+// interrupt or the next armed timer deadline, so it costs no host CPU.
+
+void cpu_idle(void) {
+    struct cpu *c = this_cpu();
+
+    // Drain leftover bottom halves first; queued work is the worker
+    // thread's, which a wake puts on the run queue
+    if (softirq_pending()) {
+        softirq_run();
+        return;
+    }
+
+    // Waiting thread: let the others run before sleeping the hart
+    if (thread_runnable()) {
+        thread_yield();
+        return;
+    }
+
+    uint64_t start = clock_now();
+    wfi();
+    c->idle_time += clock_now() - start;
+    c->idle_entries++;
+}
+
+void cpu_print_stats(void) {
+    uint64_t now = clock_now();
+
+    uart_puts("HART  UP(ms)    BUSY(ms)  IDLE(ms)  IDLE%  WAKEUPS  IPIS  FPSAVES  FPLOADS\n");
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        struct cpu *c = &cpus[i];
+        if (!c->online) continue;
+
+        uint64_t up = now - c->online_since;
+        uint64_t idle = c->idle_time;
+        if (idle > up) idle = up;
+
+        uart_putdec(c->hartid);
+        uart_puts("     ");
+        uart_putdec(clock_to_ms(up));
+        uart_puts("  ");
+        uart_putdec(clock_to_ms(up - idle));
+        uart_puts("  ");
+        uart_putdec(clock_to_ms(idle));
+        uart_puts("  ");
+        uart_putdec(up ? idle * 100 / up : 0);
+        uart_puts("%  ");
+        uart_putdec(c->idle_entries);
+        uart_puts("  ");
+        uart_putdec(c->ipi_received);
+        uart_puts("  ");
+        uart_putdec(c->fpu_saves);
+        uart_puts("  ");
+        uart_putdec(c->fpu_restores);
+        uart_puts("\n");
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef CPU_H
+#define CPU_H
+
+#define MAX_HARTS 8
+#define HART_STACK_SIZE 8192    // Boot stack of each secondary hart
+
+#ifndef __ASSEMBLER__
+
+#include "stdint.h"
+
+struct work;
+struct thread;
+
+// Per-hart state. Each hart keeps a pointer to its own entry in tp,
+// which kernel C code never touches (no TLS in a freestanding build).
+struct cpu {
+    uint64_t hartid;            // Hardware hart id (as passed by SBI)
+    unsigned int id;            // Logical index into cpus[]
+    int online;                 // Set once its per-hart init is done
+
+    // Idle accounting, in clock ticks
+    uint64_t online_since;      // Clock value when the hart came up
+    uint64_t idle_time;         // Total time spent in wfi
+    uint64_t idle_entries;      // Number of wfi sleeps
+
+    // Inter-processor interrupts (ipi.c)
+    volatile uint64_t ipi_pending;  // Bitmask of IPI_* messages
+    uint64_t ipi_received;
+
+    // Deferred work (softirq.c, work.c)
+    uint32_t softirq_pending;   // Bitmask of raised SOFTIRQ_* vectors
+    int in_softirq;
+    struct work *work_head;
+    struct work *work_tail;
+
+    // Latency stamps (latency.c), clock values
+    uint64_t irq_entry;         // Entry of the interrupt being handled
+    uint64_t softirq_raised;    // First raise since the vectors last ran
+
+    // Threads (thread.c)
+    struct thread *current;     // NULL until thread_init
+    struct thread *idle;        // Runs when the run queue is empty
+    struct thread *switch_prev; // Thread we just switched away from
+    uint64_t nr_switches;
+    int need_resched;           // Timeslice over: switch at interrupt exit
+    int preempt_count;          // Non-zero: no preemption on this hart
+    int irq_depth;              // Nesting of trap_irq
+
+    // Lazy FP/vector switching (fpu.c)
+    struct thread *fpu_owner;   // Thread whose state the registers hold
+    uint64_t fpu_saves;
+    uint64_t fpu_restores;
+};
+
+extern struct cpu cpus[MAX_HARTS];
+
+static inline struct cpu *this_cpu(void) {
+    struct cpu *c;
+    asm volatile("mv %0, tp" : "=r"(c));
+    return c;
+}
+
+// Bind the calling hart to cpus[id]
+void cpu_init(unsigned int id, uint64_t hartid);
+
+// Mark the calling hart online (after all of its per-hart init)
+void cpu_set_online(void);
+
+// Sleep until the next interrupt, charging the time to idle.
+// Call with interrupts disabled after checking the wake-up condition;
+// the pending interrupt is taken once the caller re-enables them.
+// If softirqs are pending, or another thread is ready to run, it runs
+// those instead and returns at once, so the caller re-checks its
+// condition.
+void cpu_idle(void);
+
+// Per-hart idle/busy summary (cpustat command)
+void cpu_print_stats(void);
+
+// Bitmask of logical ids of harts that are online
+uint64_t cpu_online_mask(void);
+unsigned int cpu_count(void);
+
+#endif // __ASSEMBLER__
+
+#endif
@@ -0,0 +1,188 @@
+#include "stdint.h"
+#include "libstr.h"
+#include "fdt.h"
+
+//--------------------------------------------------
+//         FLATTENED DEVICE TREE (READ-ONLY)
+//--------------------------------------------------
+// Just enough of the FDT format to read a few boot-time properties.
+// All header fields and tokens are big-endian 32-bit words.
+
+#define FDT_MAGIC       0xd00dfeed
+#define FDT_BEGIN_NODE  1
+#define FDT_END_NODE    2
+#define FDT_PROP        3
+#define FDT_NOP         4
+#define FDT_END         9
+
+#define FDT_MAX_DEPTH   8
+
+static const uint8_t *fdt_base = NULL;
+
+static uint32_t be32(const void *p) {
+    const uint8_t *b = p;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+           ((uint32_t)b[2] << 8)  |  (uint32_t)b[3];
+}
+
+int fdt_init(const void *dtb) {
+    if (!dtb || be32(dtb) != FDT_MAGIC) return -1;
+    fdt_base = dtb;
+    return 0;
+}
+
+uint64_t fdt_read_cells(const void *prop, int len) {
+    if (len == 8) return ((uint64_t)be32(prop) << 32) | be32((const uint8_t *)prop + 4);
+    return be32(prop);
+}
+
+// Does node name `name` match path component comp[0..len)?
+static int node_matches(const char *name, const char *comp, int len) {
+    int has_unit = 0;
+    for (int i = 0; i < len; i++)
+        if (comp[i] == '@') has_unit = 1;
+
+    if (strncmp(name, comp, len) != 0) return 0;
+    if (name[len] == '\0') return 1;
+    return !has_unit && name[len] == '@';   // "cpu" matches "cpu@0"
+}
+
+// Length of the next path component starting at p (stops at '/' or end)
+static int comp_len(const char *p) {
+    int n = 0;
+    while (p[n] && p[n] != '/') n++;
+    return n;
+}
+
+const void *fdt_get_prop(const char *path, const char *name, int *len) {
+    if (!fdt_base) return NULL;
+
+    const uint8_t *structs = fdt_base + be32(fdt_base + 8);
+    const char *strings = (const char *)fdt_base + be32(fdt_base + 12);
+    const uint8_t *p = structs;
+
+    // matched[d] = path position after matching depth d (0 = root)
+    const char *matched[FDT_MAX_DEPTH + 1];
+    int depth = -1;             // Current node depth
+    int good = -1;              // Deepest depth that still matches path
+
+    while (*path == '/') path++;
+
+    for (;;) {
+        uint32_t tok = be32(p);
+        p += 4;
+
+        if (tok == FDT_BEGIN_NODE) {
+            const char *node = (const char *)p;
+            unsigned int nlen = strlen(node);
+            p += (nlen + 4) & ~3U;          // Name + NUL, padded to 4
+            depth++;
+
+            if (depth == 0) {
+                matched[0] = path;
+                good = 0;
+            } else if (good == depth - 1 && depth <= FDT_MAX_DEPTH) {
+                const char *want = matched[depth - 1];
+                int clen = comp_len(want);
+                if (clen > 0 && node_matches(node, want, clen)) {
+                    want += clen;
+                    while (*want == '/') want++;
+                    matched[depth] = want;
+                    good = depth;
+                }
+            }
+        } else if (tok == FDT_END_NODE) {
+            if (good == depth) good--;
+            depth--;
+        } else if (tok == FDT_PROP) {
+            uint32_t plen = be32(p);
+            uint32_t nameoff = be32(p + 4);
+            const uint8_t *value = p + 8;
+            p += 8 + ((plen + 3) & ~3U);
+
+            // Property of the node the whole path resolved to?
+            if (good == depth && depth >= 0 && *matched[depth] == '\0' &&
+                strcmp(strings + nameoff, name) == 0) {
+                if (len) *len = plen;
+                return value;
+            }
+        } else if (tok == FDT_NOP) {
+            continue;
+        } else {
+            break;              // FDT_END or corrupt blob
+        }
+    }
+    return NULL;
+}
+
+//--------------------------------------------------
+//              LOOKUP BY COMPATIBLE
+//--------------------------------------------------
+// A node is named by the offset of its FDT_BEGIN_NODE token in the
+// structure block. Properties come before a node's subnodes, so the
+// last node begun is the one a property belongs to.
+
+// Does the string list (NUL-separated) contain s?
+static int strlist_has(const char *list, int len, const char *s) {
+    int off = 0;
+    while (off < len) {
+        if (strcmp(list + off, s) == 0) return 1;
+        off += strlen(list + off) + 1;
+    }
+    return 0;
+}
+
+int fdt_find_compatible(int from, const char *compat) {
+    if (!fdt_base) return -1;
+
+    const uint8_t *structs = fdt_base + be32(fdt_base + 8);
+    const char *strings = (const char *)fdt_base + be32(fdt_base + 12);
+    const uint8_t *p = structs;
+    int node = -1;
+
+    for (;;) {
+        uint32_t tok = be32(p);
+        if (tok == FDT_BEGIN_NODE) {
+            node = p - structs;
+            p += 4 + ((strlen((const char *)p + 4) + 4) & ~3U);
+        } else if (tok == FDT_PROP) {
+            uint32_t plen = be32(p + 4);
+            uint32_t nameoff = be32(p + 8);
+            const char *value = (const char *)p + 12;
+            p += 12 + ((plen + 3) & ~3U);
+            if (node > from && strcmp(strings + nameoff, "compatible") == 0 &&
+                strlist_has(value, plen, compat))
+                return node;
+        } else if (tok == FDT_END_NODE || tok == FDT_NOP) {
+            p += 4;
+        } else {
+            return -1;          // FDT_END or corrupt blob
+        }
+    }
+}
+
+const void *fdt_node_prop(int node, const char *name, int *len) {
+    if (!fdt_base || node < 0) return NULL;
+
+    const uint8_t *structs = fdt_base + be32(fdt_base + 8);
+    const char *strings = (const char *)fdt_base + be32(fdt_base + 12);
+    const uint8_t *p = structs + node;
+    if (be32(p) != FDT_BEGIN_NODE) return NULL;
+    p += 4 + ((strlen((const char *)p + 4) + 4) & ~3U);
+
+    for (;;) {
+        uint32_t tok = be32(p);
+        if (tok == FDT_NOP) {
+            p += 4;
+            continue;
+        }
+        if (tok != FDT_PROP) return NULL;   // Subnodes or end of node
+        uint32_t plen = be32(p + 4);
+        uint32_t nameoff = be32(p + 8);
+        if (strcmp(strings + nameoff, name) == 0) {
+            if (len) *len = plen;
+            return p + 12;
+        }
+        p += 12 + ((plen + 3) & ~3U);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef FDT_H
+#define FDT_H
+
+#include "stdint.h"
+
+// Remember the device tree blob SBI handed us; returns 0 if it is valid
+int fdt_init(const void *dtb);
+
+// Look up a property by node path ("/cpus", "/cpus/cpu@0", ...).
+// A path component without "@unit" matches any unit address.
+// Returns a pointer to the raw big-endian value, or NULL if absent.
+const void *fdt_get_prop(const char *path, const char *name, int *len);
+
+// Offset of the first node after `from` (-1: from the start) whose
+// "compatible" list contains compat, or -1 if there is none
+int fdt_find_compatible(int from, const char *compat);
+
+// Like fdt_get_prop, for a node found by fdt_find_compatible
+const void *fdt_node_prop(int node, const char *name, int *len);
+
+// Decode a property made of 1 or 2 big-endian 32-bit cells
+uint64_t fdt_read_cells(const void *prop, int len);
+
+#endif
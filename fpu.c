@@ -0,0 +1,251 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "libstr.h"
+#include "io.h"
+#include "trap.h"
+#include "cpu.h"
+#include "thread.h"
+#include "fpu.h"
+
+//--------------------------------------------------
+//            REGISTER SAVE / RESTORE
+//--------------------------------------------------
+
+static void fp_save(struct fpu_state *s) {
+    asm volatile(
+        "fsd f0, 0(%0)\n"
+        "fsd f1, 8(%0)\n"
+        "fsd f2, 16(%0)\n"
+        "fsd f3, 24(%0)\n"
+        "fsd f4, 32(%0)\n"
+        "fsd f5, 40(%0)\n"
+        "fsd f6, 48(%0)\n"
+        "fsd f7, 56(%0)\n"
+        "fsd f8, 64(%0)\n"
+        "fsd f9, 72(%0)\n"
+        "fsd f10, 80(%0)\n"
+        "fsd f11, 88(%0)\n"
+        "fsd f12, 96(%0)\n"
+        "fsd f13, 104(%0)\n"
+        "fsd f14, 112(%0)\n"
+        "fsd f15, 120(%0)\n"
+        "fsd f16, 128(%0)\n"
+        "fsd f17, 136(%0)\n"
+        "fsd f18, 144(%0)\n"
+        "fsd f19, 152(%0)\n"
+        "fsd f20, 160(%0)\n"
+        "fsd f21, 168(%0)\n"
+        "fsd f22, 176(%0)\n"
+        "fsd f23, 184(%0)\n"
+        "fsd f24, 192(%0)\n"
+        "fsd f25, 200(%0)\n"
+        "fsd f26, 208(%0)\n"
+        "fsd f27, 216(%0)\n"
+        "fsd f28, 224(%0)\n"
+        "fsd f29, 232(%0)\n"
+        "fsd f30, 240(%0)\n"
+        "fsd f31, 248(%0)\n"
+        :: "r"(s->f) : "memory");
+    s->fcsr = csr_read(fcsr);
+}
+
+static void fp_restore(struct fpu_state *s) {
+    asm volatile(
+        "fld f0, 0(%0)\n"
+        "fld f1, 8(%0)\n"
+        "fld f2, 16(%0)\n"
+        "fld f3, 24(%0)\n"
+        "fld f4, 32(%0)\n"
+        "fld f5, 40(%0)\n"
+        "fld f6, 48(%0)\n"
+        "fld f7, 56(%0)\n"
+        "fld f8, 64(%0)\n"
+        "fld f9, 72(%0)\n"
+        "fld f10, 80(%0)\n"
+        "fld f11, 88(%0)\n"
+        "fld f12, 96(%0)\n"
+        "fld f13, 104(%0)\n"
+        "fld f14, 112(%0)\n"
+        "fld f15, 120(%0)\n"
+        "fld f16, 128(%0)\n"
+        "fld f17, 136(%0)\n"
+        "fld f18, 144(%0)\n"
+        "fld f19, 152(%0)\n"
+        "fld f20, 160(%0)\n"
+        "fld f21, 168(%0)\n"
+        "fld f22, 176(%0)\n"
+        "fld f23, 184(%0)\n"
+        "fld f24, 192(%0)\n"
+        "fld f25, 200(%0)\n"
+        "fld f26, 208(%0)\n"
+        "fld f27, 216(%0)\n"
+        "fld f28, 224(%0)\n"
+        "fld f29, 232(%0)\n"
+        "fld f30, 240(%0)\n"
+        "fld f31, 248(%0)\n"
+        :: "r"(s->f) : "memory");
+    csr_write(fcsr, s->fcsr);
+}
+
+#ifdef __riscv_vector
+static int fpu_has_v;
+
+// Whole-register moves, eight registers at a time; they ignore vl and
+// vtype, which are saved separately
+static void v_save(struct fpu_state *s) {
+    uint64_t vlenb = csr_read(vlenb);
+    uint8_t *p = s->v;
+    s->vstart = csr_read(vstart);
+    s->vl = csr_read(vl);
+    s->vtype = csr_read(vtype);
+    s->vcsr = csr_read(vcsr);
+    asm volatile("vs8r.v v0, (%0)" :: "r"(p) : "memory");
+    asm volatile("vs8r.v v8, (%0)" :: "r"(p + 8 * vlenb) : "memory");
+    asm volatile("vs8r.v v16, (%0)" :: "r"(p + 16 * vlenb) : "memory");
+    asm volatile("vs8r.v v24, (%0)" :: "r"(p + 24 * vlenb) : "memory");
+}
+
+static void v_restore(struct fpu_state *s) {
+    uint64_t vlenb = csr_read(vlenb);
+    uint8_t *p = s->v;
+    asm volatile("vl8re8.v v0, (%0)" :: "r"(p) : "memory");
+    asm volatile("vl8re8.v v8, (%0)" :: "r"(p + 8 * vlenb) : "memory");
+    asm volatile("vl8re8.v v16, (%0)" :: "r"(p + 16 * vlenb) : "memory");
+    asm volatile("vl8re8.v v24, (%0)" :: "r"(p + 24 * vlenb) : "memory");
+    asm volatile("vsetvl x0, %0, %1" :: "r"(s->vl), "r"(s->vtype) : "memory");
+    csr_write(vstart, s->vstart);
+    csr_write(vcsr, s->vcsr);
+}
+#endif
+
+// Set a 2-bit FS/VS field of sstatus
+static void set_xs(unsigned int shift, uint64_t val) {
+    csr_clear(sstatus, XS_DIRTY << shift);
+    csr_set(sstatus, val << shift);
+}
+
+static uint64_t get_xs(unsigned int shift) {
+    return (csr_read(sstatus) >> shift) & XS_DIRTY;
+}
+
+//--------------------------------------------------
+//                 SWITCH AND TRAP
+//--------------------------------------------------
+
+void fpu_init_hart(void) {
+    set_xs(SSTATUS_FS_SHIFT, XS_OFF);
+    set_xs(SSTATUS_VS_SHIFT, XS_OFF);
+}
+
+void fpu_init(void) {
+#ifdef __riscv_vector
+    // VS is WARL: it stays 0 on harts without V
+    set_xs(SSTATUS_VS_SHIFT, XS_INITIAL);
+    fpu_has_v = get_xs(SSTATUS_VS_SHIFT) != XS_OFF;
+    if (fpu_has_v && csr_read(vlenb) > FPU_VLENB_MAX) {
+        uart_puts("FPU: vector registers too large to save, vector disabled\n");
+        fpu_has_v = 0;
+    }
+#endif
+    fpu_init_hart();
+}
+
+void fpu_reset(struct fpu_state *s) {
+    memset(s, 0, sizeof(*s));
+    s->loaded_on = -1;
+}
+
+// The hardware marks a unit dirty on any register write, so a thread
+// that only read its FP registers (or never had them on) saves nothing
+void fpu_switch(struct thread *prev, struct thread *next) {
+    struct cpu *c = this_cpu();
+
+    if (prev->state != THREAD_ZOMBIE) {
+        if (get_xs(SSTATUS_FS_SHIFT) == XS_DIRTY) {
+            fp_save(&prev->fpu);
+            c->fpu_saves++;
+        }
+#ifdef __riscv_vector
+        if (get_xs(SSTATUS_VS_SHIFT) == XS_DIRTY) {
+            v_save(&prev->fpu);
+            c->fpu_saves++;
+        }
+#endif
+    }
+
+    // Still next's registers if nothing else was loaded here since
+    int warm = c->fpu_owner == next && next->fpu.loaded_on == (int)c->id;
+    set_xs(SSTATUS_FS_SHIFT, warm && (next->fpu.used & FPU_USED_FP) ? XS_CLEAN : XS_OFF);
+    set_xs(SSTATUS_VS_SHIFT, warm && (next->fpu.used & FPU_USED_V) ? XS_CLEAN : XS_OFF);
+}
+
+// Unit an instruction needs, from its encoding: FPU_USED_FP, FPU_USED_V
+// (vector instructions may also need FP) or 0
+static int insn_unit(uint32_t insn) {
+    if ((insn & 0x3) != 0x3) {
+        // c.fld, c.fsd, c.fldsp, c.fsdsp
+        uint32_t op = insn & 0x3, funct3 = (insn >> 13) & 0x7;
+        return (op != 1 && (funct3 == 1 || funct3 == 5)) ? FPU_USED_FP : 0;
+    }
+
+    uint32_t funct3 = (insn >> 12) & 0x7;
+    uint32_t csr = insn >> 20;
+    switch (insn & 0x7f) {
+    case 0x07:                  // LOAD-FP / STORE-FP: widths 1-4 are scalar
+    case 0x27:
+        return (funct3 >= 1 && funct3 <= 4) ? FPU_USED_FP : FPU_USED_V;
+    case 0x43: case 0x47: case 0x4b: case 0x4f: case 0x53:
+        return FPU_USED_FP;
+    case 0x57:                  // OP-V, vset*vl*
+        return FPU_USED_V;
+    case 0x73:                  // CSR access to fflags/frm/fcsr or vector CSRs
+        if (funct3 == 0 || funct3 == 4) return 0;
+        if (csr >= 0x001 && csr <= 0x003) return FPU_USED_FP;
+        // vstart, vxsat, vxrm, vcsr; vl, vtype, vlenb
+        if ((csr >= 0x008 && csr <= 0x00a) || csr == 0x00f ||
+            (csr >= 0xc20 && csr <= 0xc22))
+            return FPU_USED_V;
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+int fpu_trap(struct trap_frame *tf) {
+    struct cpu *c = this_cpu();
+    struct thread *t = c->current;
+    if (!t || t == c->idle || c->irq_depth || c->in_softirq) return 0;
+
+    uint32_t insn = *(volatile uint16_t *)tf->sepc;
+    if ((insn & 0x3) == 0x3) insn |= (uint32_t)*(volatile uint16_t *)(tf->sepc + 2) << 16;
+    int unit = insn_unit(insn);
+
+    // Units this instruction needs that are off right now
+    int missing = 0;
+    if (unit && get_xs(SSTATUS_FS_SHIFT) == XS_OFF) missing |= FPU_USED_FP;
+#ifdef __riscv_vector
+    if ((unit & FPU_USED_V) && fpu_has_v && get_xs(SSTATUS_VS_SHIFT) == XS_OFF)
+        missing |= FPU_USED_V;
+#endif
+    if (!missing) return 0;
+
+    // Load only units that are off: one that is on already holds t's
+    // registers, possibly newer than the saved copy
+    t->fpu.used |= missing;
+    if (missing & FPU_USED_FP) {
+        set_xs(SSTATUS_FS_SHIFT, XS_CLEAN);
+        fp_restore(&t->fpu);
+        set_xs(SSTATUS_FS_SHIFT, XS_CLEAN);     // The loads marked it dirty
+    }
+#ifdef __riscv_vector
+    if (missing & FPU_USED_V) {
+        set_xs(SSTATUS_VS_SHIFT, XS_CLEAN);
+        v_restore(&t->fpu);
+        set_xs(SSTATUS_VS_SHIFT, XS_CLEAN);
+    }
+#endif
+    c->fpu_owner = t;
+    t->fpu.loaded_on = c->id;
+    c->fpu_restores++;
+    return 1;
+}
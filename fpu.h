@@ -0,0 +1,53 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include "stdint.h"
+
+struct thread;
+struct trap_frame;
+
+//--------------------------------------------------
+//           LAZY FP / VECTOR SWITCHING
+//--------------------------------------------------
+// Threads start with sstatus.FS (and VS) off, so their first FP or
+// vector instruction traps; the trap loads the thread's saved state and
+// turns the unit on. On a switch the outgoing state is saved only if
+// the hardware marked it dirty, and the incoming thread finds the unit
+// on without a reload if its state is still the one in the registers.
+// Threads that never touch FP pay for neither.
+//
+// Interrupt handlers and softirqs must not use FP or vector registers:
+// they would clobber the interrupted thread's state.
+
+#define FPU_VLENB_MAX 64        // Largest vector register (bytes) we save
+
+struct fpu_state {
+    uint64_t f[32];
+    uint64_t fcsr;
+#ifdef __riscv_vector
+    uint64_t vstart, vl, vtype, vcsr;
+    uint8_t v[32 * FPU_VLENB_MAX] __attribute__((aligned(16)));
+#endif
+    int loaded_on;              // Hart that last loaded it, -1 if none
+    int used;                   // FPU_USED_* units touched so far
+};
+
+#define FPU_USED_FP  1
+#define FPU_USED_V   2
+
+// Turn both units off on this hart (boot hart: fpu_init also detects
+// vector support; secondary harts: fpu_init_hart)
+void fpu_init(void);
+void fpu_init_hart(void);
+
+// Fresh, zeroed state for a new thread
+void fpu_reset(struct fpu_state *s);
+
+// Called by schedule with interrupts off, just before switching
+void fpu_switch(struct thread *prev, struct thread *next);
+
+// Illegal-instruction hook: returns 1 if the trap was a first FP or
+// vector use and the instruction should be retried
+int fpu_trap(struct trap_frame *tf);
+
+#endif
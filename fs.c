@@ -1,11 +1,27 @@
 #include "stdint.h"
 #include "io.h"
 #include "libstr.h"
+#include "lock.h"
+#include "wait.h"
+#include "thread.h"
 #include "fs.h"
 
 #define NULL ((void*)0)
 
 
+//--------------------------------------------------
+//                 FILESYSTEM LOCK
+//--------------------------------------------------
+// One lock covers the node pool and every directory's children (the
+// working directory is per task, see fs_ctx).
+// The public fs_* operations below take it around the do_* bodies, so
+// they are safe from any thread; helpers expect it held. It is a
+// sleeping mutex: ls and cat hold it while printing, and a contender
+// should give its hart to other threads rather than spin that long.
+
+static struct lock_stats fs_lock_stats = LOCK_STATS_INIT("fs");
+static struct mutex fs_lock = MUTEX_INIT_STATS(&fs_lock_stats);
+
 //--------------------------------------------------
 //            NODE POOL FOR ALLOCATION
 //--------------------------------------------------
@@ -24,7 +40,7 @@ Node* fs_alloc_node(void) {
     for (unsigned int i = 0; i < MAX_FILES; i++) n->children[i] = NULL;
     n->child_count = 0;
     for (unsigned int i = 0; i < MAX_NAME; i++) n->name[i] = 0;
-    for (unsigned int i = 0; i < 128; i++) n->content[i] = 0;
+    for (unsigned int i = 0; i < FS_CONTENT_SIZE; i++) n->content[i] = 0;
     n->parent = NULL;
     n->permissions = PERM_RW;  // Default: read + write
     n->flags = 0;              // No special flags
@@ -61,17 +77,27 @@ int fs_is_hidden(Node *node) {
 //--------------------------------------------------
 
 Node root;     // The root directory node
-Node *cwd;     // Current working directory pointer
+
+// Calling task's directory context. Threads start with their creator's;
+// those created before fs_init (and idle threads) start at the root.
+static struct fs_context *fs_ctx(void) {
+    struct fs_context *ctx = &thread_current()->fs;
+    if (!ctx->root) {
+        ctx->root = &root;
+        ctx->cwd = &root;
+    }
+    return ctx;
+}
 
 // Initialize filesystem: create root directory and system directories
 void fs_init(void) {
+    lock_stats_register(&fs_lock_stats);
+
     Node *r = fs_alloc_node();
     r->type = DIR_NODE;
     r->permissions = PERM_RWX;      // Full access to root
     r->flags = FLAG_SYSTEM;         // Root is protected
-    cwd = r;
-    root = *r;     // Copy struct
-    cwd = &root;   // Use root as actual object
+    root = *r;     // Copy struct; root is the actual object
 
     // Create protected system directories
     // /bin - system binaries (protected)
@@ -137,10 +163,11 @@ Node *fs_find(Node *dir, const char *name) {
 // Walk through a path (supports /, ., ..)
 // If create_missing = 1 → create directories while traversing
 Node* fs_traverse_path(const char *path, int create_missing) {
-    Node *current = cwd;
+    struct fs_context *ctx = fs_ctx();
+    Node *current = ctx->cwd;
 
-    // Absolute path → start at root
-    if (*path == '/') current = &root;
+    // Absolute path → start at the task's root
+    if (*path == '/') current = ctx->root;
 
     char temp[MAX_NAME];
     int i = 0;
@@ -163,9 +190,9 @@ Node* fs_traverse_path(const char *path, int create_missing) {
             if (strcmp(temp, ".") == 0) {
                 // no-op
             }
-            // Handle ".." → go up one directory
+            // Handle ".." → go up one directory, but not above root
             else if (strcmp(temp, "..") == 0) {
-                if (current->parent)
+                if (current->parent && current != ctx->root)
                     current = current->parent;
             }
             // Normal directory name
@@ -209,7 +236,7 @@ Node* fs_traverse_path(const char *path, int create_missing) {
 }
 
 // Create directory (mkdir)
-void fs_mkdir(const char *path) {
+static void do_mkdir(const char *path) {
     const char *last_slash = 0;
 
     // Find last slash to separate parent and name
@@ -239,7 +266,7 @@ void fs_mkdir(const char *path) {
     }
 
     // Parent directory lookup
-    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : cwd;
+    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : fs_ctx()->cwd;
     if (!parent) return;
 
     // PROTECTION: Check write permission on parent directory
@@ -314,7 +341,7 @@ static void fs_touch_internal(const char *path, unsigned int perms) {
         file_name[j] = 0;
     }
 
-    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : cwd;
+    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : fs_ctx()->cwd;
     if (!parent) return;
 
     // PROTECTION: Check write permission on parent directory
@@ -346,12 +373,12 @@ static void fs_touch_internal(const char *path, unsigned int perms) {
 }
 
 // Create empty file with default permissions (touch)
-void fs_touch(const char *path) {
+static void do_touch(const char *path) {
     fs_touch_internal(path, PERM_RW);  // Default: read + write
 }
 
 // Create file with specific permissions
-void fs_touch_with_perms(const char *path, unsigned int perms) {
+static void do_touch_with_perms(const char *path, unsigned int perms) {
     fs_touch_internal(path, perms);
 }
 
@@ -361,7 +388,7 @@ static void fs_ls_internal(const char *path, int show_hidden) {
 
     // No path → use cwd
     if (!path || *path == '\0') {
-        dir = cwd;
+        dir = fs_ctx()->cwd;
     } else {
         dir = fs_traverse_path(path, 0);
         if (!dir) return;
@@ -398,17 +425,17 @@ static void fs_ls_internal(const char *path, int show_hidden) {
 }
 
 // List directory contents (ls) - hides hidden files
-void fs_ls(const char *path) {
+static void do_ls(const char *path) {
     fs_ls_internal(path, 0);
 }
 
 // List all files including hidden (ls -a)
-void fs_ls_all(const char *path) {
+static void do_ls_all(const char *path) {
     fs_ls_internal(path, 1);
 }
 
 // Change directory (cd)
-void fs_cd(const char *path) {
+static void do_cd(const char *path) {
     Node *target = fs_traverse_path(path, 0);
     if (target) {
         // PROTECTION: Check execute permission (required to enter directory)
@@ -416,25 +443,24 @@ void fs_cd(const char *path) {
             uart_puts("Permission denied: cannot enter this directory.\n");
             return;
         }
-        cwd = target;
+        fs_ctx()->cwd = target;
     }
 }
 
-// Print working directory (pwd)
+// Print working directory (pwd), relative to the task's root
 void fs_pwd_recursive(Node *n) {
-    if (n->parent == 0) {
+    Node *top = fs_ctx()->root;
+    if (n == top || n->parent == 0) {
         uart_puts("/");
         return;
     }
     fs_pwd_recursive(n->parent);
-    if (n != &root) {
-        uart_putc('/');
-        uart_puts(n->name);
-    }
+    if (n->parent != top) uart_putc('/');
+    uart_puts(n->name);
 }
 
-void fs_pwd(void) {
-    fs_pwd_recursive(cwd);
+static void do_pwd(void) {
+    fs_pwd_recursive(fs_ctx()->cwd);
     uart_puts("\n");
 }
 
@@ -443,7 +469,7 @@ void fs_pwd(void) {
 //==================================================
 
 // Write text into file
-void fs_write(const char *path, const char *text) {
+static void do_write(const char *path, const char *text) {
     const char *last_slash = NULL;
 
     // Separate path into parent + filename
@@ -474,7 +500,7 @@ void fs_write(const char *path, const char *text) {
     }
 
     // Find parent
-    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : cwd;
+    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : fs_ctx()->cwd;
     if (!parent) return;
 
     // File must exist
@@ -498,7 +524,7 @@ void fs_write(const char *path, const char *text) {
 }
 
 // Print file content
-void fs_cat(const char *path) {
+static void do_cat(const char *path) {
     const char *last_slash = NULL;
 
     // Extract parent and file name
@@ -527,7 +553,7 @@ void fs_cat(const char *path) {
         file_name[j] = 0;
     }
 
-    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : cwd;
+    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : fs_ctx()->cwd;
     if (!parent) return;
 
     Node *file = fs_find(parent, file_name);
@@ -577,7 +603,7 @@ static Node* fs_find_with_parent(const char *path, Node **out_parent) {
         name[j] = 0;
     }
 
-    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : cwd;
+    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : fs_ctx()->cwd;
     if (!parent) return NULL;
 
     *out_parent = parent;
@@ -585,7 +611,7 @@ static Node* fs_find_with_parent(const char *path, Node **out_parent) {
 }
 
 // Remove a file (rm)
-void fs_rm(const char *path) {
+static void do_rm(const char *path) {
     if (!path || *path == '\0') {
         uart_puts("Usage: rm <filename>\n");
         return;
@@ -631,7 +657,7 @@ void fs_rm(const char *path) {
 }
 
 // Remove empty directory (rmdir)
-void fs_rmdir(const char *path) {
+static void do_rmdir(const char *path) {
     if (!path || *path == '\0') {
         uart_puts("Usage: rmdir <dirname>\n");
         return;
@@ -694,7 +720,7 @@ static void perm_to_str(unsigned int perms, char *buf) {
 }
 
 // Change file/directory permissions (chmod)
-void fs_chmod(const char *path, unsigned int perms) {
+static void do_chmod(const char *path, unsigned int perms) {
     if (!path || *path == '\0') {
         uart_puts("Usage: chmod <path> <perms>\n");
         return;
@@ -730,7 +756,7 @@ void fs_chmod(const char *path, unsigned int perms) {
 }
 
 // Show file/directory information (stat)
-void fs_stat(const char *path) {
+static void do_stat(const char *path) {
     if (!path || *path == '\0') {
         uart_puts("Usage: stat <path>\n");
         return;
@@ -804,7 +830,7 @@ void fs_stat(const char *path) {
 
 // Get executable file content (checks permissions)
 // Returns pointer to content if executable, NULL otherwise
-const char* fs_get_executable(const char *path) {
+static const char* do_get_executable(const char *path) {
     if (!path || *path == '\0') {
         uart_puts("Usage: exec <filename>\n");
         return 0;
@@ -838,8 +864,7 @@ const char* fs_get_executable(const char *path) {
     }
 
     // Find the file
-    extern Node *cwd;
-    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : cwd;
+    Node *parent = (*parent_path) ? fs_traverse_path(parent_path, 0) : fs_ctx()->cwd;
     if (!parent) return 0;
 
     Node *file = fs_find(parent, file_name);
@@ -873,4 +898,99 @@ const char* fs_get_executable(const char *path) {
     }
 
     return file->content;
-}
\ No newline at end of file
+}
+
+//==================================================
+//              LOCKED ENTRY POINTS
+//==================================================
+
+void fs_mkdir(const char *path) {
+    mutex_lock(&fs_lock);
+    do_mkdir(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_touch(const char *path) {
+    mutex_lock(&fs_lock);
+    do_touch(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_touch_with_perms(const char *path, unsigned int perms) {
+    mutex_lock(&fs_lock);
+    do_touch_with_perms(path, perms);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_ls(const char *path) {
+    mutex_lock(&fs_lock);
+    do_ls(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_ls_all(const char *path) {
+    mutex_lock(&fs_lock);
+    do_ls_all(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_cd(const char *path) {
+    mutex_lock(&fs_lock);
+    do_cd(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_pwd(void) {
+    mutex_lock(&fs_lock);
+    do_pwd();
+    mutex_unlock(&fs_lock);
+}
+
+void fs_write(const char *path, const char *text) {
+    mutex_lock(&fs_lock);
+    do_write(path, text);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_cat(const char *path) {
+    mutex_lock(&fs_lock);
+    do_cat(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_rm(const char *path) {
+    mutex_lock(&fs_lock);
+    do_rm(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_rmdir(const char *path) {
+    mutex_lock(&fs_lock);
+    do_rmdir(path);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_chmod(const char *path, unsigned int perms) {
+    mutex_lock(&fs_lock);
+    do_chmod(path, perms);
+    mutex_unlock(&fs_lock);
+}
+
+void fs_stat(const char *path) {
+    mutex_lock(&fs_lock);
+    do_stat(path);
+    mutex_unlock(&fs_lock);
+}
+
+// The content is copied out under the lock: once it is dropped another
+// hart may rewrite or delete the file while the script runs
+int fs_get_executable(const char *path, char *buf) {
+    mutex_lock(&fs_lock);
+    const char *content = do_get_executable(path);
+    if (content) {
+        for (int i = 0; i < FS_CONTENT_SIZE; i++) buf[i] = content[i];
+        buf[FS_CONTENT_SIZE - 1] = '\0';
+    }
+    mutex_unlock(&fs_lock);
+    return content != NULL;
+}
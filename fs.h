@@ -4,6 +4,7 @@
 #define MAX_NAME 16
 #define MAX_FILES 16
 #define MAX_NODES 64
+#define FS_CONTENT_SIZE 128
 
 // Node can be a file or directory
 typedef enum { FILE_NODE, DIR_NODE } NodeType;
@@ -26,11 +27,19 @@ typedef enum { FILE_NODE, DIR_NODE } NodeType;
 #define FLAG_SYSTEM  0x10    // System file/directory - cannot be deleted
 #define FLAG_HIDDEN  0x20    // Hidden from normal ls listing
 
+// Per-task directory context: relative paths start at cwd; absolute
+// paths start at root, and .. does not climb above it
+struct Node;
+struct fs_context {
+    struct Node *cwd;
+    struct Node *root;
+};
+
 // Basic filesystem node structure
 typedef struct Node {
     char name[MAX_NAME];
     NodeType type;
-    char content[128];          // File content area
+    char content[FS_CONTENT_SIZE]; // File content area
     struct Node *children[MAX_FILES];
     struct Node *parent;
     unsigned int child_count;
@@ -45,7 +54,8 @@ int fs_can_exec(Node *node);
 int fs_is_system(Node *node);
 int fs_is_hidden(Node *node);
 
-// Core functions
+// Core functions. Everything below except fs_init takes the filesystem
+// lock itself; the node-level helpers here expect it held.
 Node* fs_alloc_node(void);
 void fs_init(void);
 Node *fs_find(Node *dir, const char *name);
@@ -74,7 +84,8 @@ void fs_chmod(const char *path, unsigned int perms);
 void fs_stat(const char *path);         // Show file info and permissions
 
 // Program execution support
-// Returns pointer to file content if file exists and is executable, NULL otherwise
-const char* fs_get_executable(const char *path);
+// Copies the file into buf (FS_CONTENT_SIZE bytes) if it exists and is
+// executable; returns 1 on success, 0 (after printing why) otherwise
+int fs_get_executable(const char *path, char *buf);
 
 #endif
\ No newline at end of file
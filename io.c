@@ -1,30 +1,357 @@
 #include "stdint.h"
+#include "riscv.h"
+#include "irq.h"
+#include "lock.h"
+#include "spin.h"
+#include "wait.h"
+#include "cpu.h"
+#include "softirq.h"
+#include "work.h"
+#include "latency.h"
+#include "clock.h"
+#include "atomic.h"
+#include "thread.h"
 #include "io.h"
 
 // UART MMIO register offsets and base address
 #define UART0_BASE 0x10000000
+#define UART0_IRQ  10           // PLIC source for UART0 on QEMU virt
 #define UART_TX    0x00
 #define UART_RX    0x00
+#define UART_IER   0x01         // Interrupt Enable Register offset
+#define UART_FCR   0x02         // FIFO Control Register offset (write)
 #define UART_LSR   0x05         // Line Status Register offset
 #define UART_LSR_DR 0x01        // Data Ready bit
+#define UART_LSR_THRE 0x20      // Transmit holding register / FIFO empty
+#define UART_IER_RDI 0x01       // Received Data Available interrupt
+#define UART_IER_THRI 0x02      // Transmit holding register empty interrupt
+#define UART_FCR_ENABLE 0x01    // Enable RX/TX FIFOs
+#define UART_FCR_CLEAR  0x06    // Reset both FIFOs
+#define UART_FIFO_SIZE 16       // 16550 TX FIFO depth
 
-// Output one byte to UART transmit register
+static inline volatile uint8_t *uart_reg(unsigned int off) {
+    return (volatile uint8_t *)(uint64_t)(UART0_BASE + off);
+}
+
+//--------------------------------------------------
+//                 RX RING BUFFER
+//--------------------------------------------------
+// Single producer (the UART interrupt) and single consumer (uart_getc),
+// so head/tail need only ordering fences, no locks. Indices run freely
+// and are masked on access. The interrupt may be routed to another hart
+// than the reader; a sleeping reader is woken through rx_wait.
+
+#define RX_RING_SIZE 256        // Must be a power of two
+
+static volatile char rx_ring[RX_RING_SIZE];
+static volatile unsigned int rx_head;   // Written by the IRQ handler
+static volatile unsigned int rx_tail;   // Written by the reader
+static uint64_t rx_arrival;             // Clock value when the ring last became non-empty
+static unsigned int rx_dropped;         // Bytes lost to a full ring
+static unsigned int rx_reported;        // rx_dropped at the last warning
+static struct work rx_drop_work;
+static struct waitqueue rx_wait = WAITQUEUE_INIT;   // Readers sleeping in uart_getc
+static int uart_irq_mode = 0;           // Set once the RX interrupt is live
+
+static void rx_push(char c) {
+    unsigned int head = rx_head;
+    if (head - rx_tail >= RX_RING_SIZE) {
+        rx_dropped++;
+        work_queue(&rx_drop_work);     // Too slow to print from the IRQ
+        return;
+    }
+    if (head == rx_tail) rx_arrival = rdtime();
+    rx_ring[head & (RX_RING_SIZE - 1)] = c;
+    wmb();                      // Publish the byte before the index
+    rx_head = head + 1;
+}
+
+static int rx_pop(char *c) {
+    unsigned int tail = rx_tail;
+    if (tail == rx_head) return 0;
+    rmb();                      // Read the index before the byte
+    *c = rx_ring[tail & (RX_RING_SIZE - 1)];
+    mb();                       // Finish the read before freeing the slot
+    rx_tail = tail + 1;
+    return 1;
+}
+
+//--------------------------------------------------
+//                 TX RING BUFFER
+//--------------------------------------------------
+// Writers append with interrupts off; the THRE interrupt drains the ring
+// a full FIFO (16 bytes) at a time, so the LSR is polled once per batch
+// rather than once per byte. Writers and the drain may run on different
+// harts, so the ring, the FIFO and the cached IER sit under tx_lock.
+
+#define TX_RING_SIZE 1024       // Must be a power of two
+
+static char tx_ring[TX_RING_SIZE];
+static unsigned int tx_head;            // Next free slot (writers)
+static unsigned int tx_tail;            // Next byte to send (drain)
+static int uart_tx_sync = 0;            // Force polled output (panic path)
+static uint8_t uart_ier;                // Cached IER, saves an MMIO read/write
+static struct lock_stats tx_lock_stats = LOCK_STATS_INIT("uart_tx");
+static spinlock_t tx_lock = SPINLOCK_INIT_STATS(&tx_lock_stats);
+
+static void uart_set_ier(uint8_t ier) {
+    if (ier == uart_ier) return;
+    uart_ier = ier;
+    *uart_reg(UART_IER) = ier;
+}
+
+// Blocking single-byte write: wait for THR empty, then send
+static void uart_putc_sync(char c) {
+    while (!(*uart_reg(UART_LSR) & UART_LSR_THRE)) cpu_relax();
+    *uart_reg(UART_TX) = c;
+}
+
+// Move up to one FIFO's worth of bytes from the ring to the UART, then
+// leave the THRE interrupt enabled only while bytes remain queued.
+// Caller must have interrupts disabled.
+static void tx_fill(void) {
+    if (*uart_reg(UART_LSR) & UART_LSR_THRE) {
+        for (int n = 0; n < UART_FIFO_SIZE && tx_tail != tx_head; n++)
+            *uart_reg(UART_TX) = tx_ring[tx_tail++ & (TX_RING_SIZE - 1)];
+    }
+    uart_set_ier((tx_tail != tx_head) ? (UART_IER_RDI | UART_IER_THRI)
+                                      : UART_IER_RDI);
+}
+
+// Synchronously push queued bytes out until the ring is empty
+static void tx_drain_sync(void) {
+    while (tx_tail != tx_head)
+        uart_putc_sync(tx_ring[tx_tail++ & (TX_RING_SIZE - 1)]);
+}
+
+// Full ring: wait for the FIFO to empty and refill it from the ring,
+// freeing up to one FIFO's worth of slots
+static void tx_make_room(void) {
+    while (!(*uart_reg(UART_LSR) & UART_LSR_THRE)) cpu_relax();
+    for (int n = 0; n < UART_FIFO_SIZE && tx_tail != tx_head; n++)
+        *uart_reg(UART_TX) = tx_ring[tx_tail++ & (TX_RING_SIZE - 1)];
+}
+
+//--------------------------------------------------
+//                 OUTPUT CAPTURE
+//--------------------------------------------------
+// Checked on every write, so a counter of attached buffers keeps the
+// common case to one load (and safe before tp is set up at boot)
+
+static volatile uint32_t captures;      // Threads with a buffer attached
+
+void outbuf_init(struct outbuf *o, char *buf, unsigned int size) {
+    o->buf = buf;
+    o->size = size;
+    o->len = 0;
+    o->truncated = 0;
+}
+
+void uart_capture(struct outbuf *o) {
+    struct thread *t = thread_current();
+    if (o && !t->out) atomic_fetch_add32(&captures, 1);
+    if (!o && t->out) atomic_fetch_add32(&captures, (uint32_t)-1);
+    t->out = o;
+}
+
+// Returns 1 if the calling thread's output went to its buffer
+static int capture_write(const char *buf, unsigned int len) {
+    struct thread *t = thread_current();
+    if (!t || !t->out) return 0;
+    struct outbuf *o = t->out;
+    for (unsigned int i = 0; i < len; i++) {
+        if (o->len == o->size) {
+            o->truncated = 1;
+            break;
+        }
+        o->buf[o->len++] = buf[i];
+    }
+    return 1;
+}
+
+// Queue a buffer for transmission. When the ring is full the writer
+// sends one FIFO's worth itself, so output is never dropped; between
+// batches it drops the lock and lets pending interrupts in, so a long
+// write holds them off for at most one FIFO's transmit time.
+static void uart_write(const char *buf, unsigned int len) {
+    if (captures && !uart_tx_sync && capture_write(buf, len)) return;
+
+    if (!uart_irq_mode || uart_tx_sync) {
+        for (unsigned int i = 0; i < len; i++) uart_putc_sync(buf[i]);
+        return;
+    }
+
+    uint64_t s = intr_save();
+    spin_lock(&tx_lock);
+    for (unsigned int i = 0; i < len; i++) {
+        while (tx_head - tx_tail >= TX_RING_SIZE) {
+            tx_make_room();
+            spin_unlock(&tx_lock);
+            intr_restore(s);
+            s = intr_save();
+            spin_lock(&tx_lock);
+        }
+        tx_ring[tx_head++ & (TX_RING_SIZE - 1)] = buf[i];
+    }
+    tx_fill();                  // Start the FIFO if it was idle
+    spin_unlock(&tx_lock);
+    intr_restore(s);
+}
+
+// UART interrupt: move everything the RX FIFO holds into the RX ring
+// (it must be emptied to drop the line). A TX FIFO refill is deferred:
+// mask THRE so the line stays quiet and let the softirq do the MMIO.
+static void uart_irq(unsigned int irq, void *arg) {
+    (void)irq; (void)arg;
+    int got = 0;
+    while (*uart_reg(UART_LSR) & UART_LSR_DR) {
+        rx_push(*uart_reg(UART_RX));
+        got = 1;
+    }
+
+    if (got) wake_one(&rx_wait);
+
+    spin_lock(&tx_lock);
+    if ((uart_ier & UART_IER_THRI) && (*uart_reg(UART_LSR) & UART_LSR_THRE)) {
+        uart_set_ier(UART_IER_RDI);
+        softirq_raise(SOFTIRQ_UART_TX);
+    }
+    spin_unlock(&tx_lock);
+}
+
+// Bottom half of the THRE interrupt
+static void uart_tx_softirq(void) {
+    uint64_t s = intr_save();
+    spin_lock(&tx_lock);
+    tx_fill();
+    spin_unlock(&tx_lock);
+    intr_restore(s);
+}
+
+// Worker: report input lost to a full RX ring
+static void rx_drop_report(struct work *w) {
+    (void)w;
+    unsigned int dropped = rx_dropped;
+    uart_puts("uart: ");
+    uart_putdec(dropped - rx_reported);
+    uart_puts(" input bytes dropped\n");
+    rx_reported = dropped;
+}
+
+// Enable the FIFOs and route UART interrupts through the PLIC
+void uart_init(void) {
+    *uart_reg(UART_FCR) = UART_FCR_ENABLE | UART_FCR_CLEAR;
+    work_init(&rx_drop_work, rx_drop_report, NULL);
+    lock_stats_register(&tx_lock_stats);
+    softirq_register(SOFTIRQ_UART_TX, uart_tx_softirq);
+    if (irq_register(UART0_IRQ, "uart0", uart_irq, NULL) != 0) return;
+    uart_set_ier(UART_IER_RDI);
+    uart_irq_mode = 1;
+}
+
+// Block until every queued byte has been handed to the UART
+void uart_flush(void) {
+    uint64_t s = intr_save();
+    spin_lock(&tx_lock);
+    tx_drain_sync();
+    if (uart_irq_mode) uart_set_ier(UART_IER_RDI);
+    spin_unlock(&tx_lock);
+    intr_restore(s);
+}
+
+// Switch to polled output for good (panic/shutdown paths, where
+// interrupts will not run again). Never waits on tx_lock for long: the
+// panicking hart, or a dead one, may hold it. Writers already in the
+// lock get a moment to finish; if it stays taken, queued bytes are lost.
+#define TX_SYNC_WAIT_MS 10
+
+void uart_force_sync(void) {
+    uart_tx_sync = 1;           // New writers poll and skip the lock
+    mb();
+    uint64_t end = clock_now() + clock_hz() / 1000 * TX_SYNC_WAIT_MS;
+    uint64_t s = intr_save();
+    while (!spin_trylock(&tx_lock)) {
+        if (clock_now() >= end) {
+            intr_restore(s);
+            return;
+        }
+        cpu_relax();
+    }
+    tx_drain_sync();
+    if (uart_irq_mode) uart_set_ier(UART_IER_RDI);
+    spin_unlock(&tx_lock);
+    intr_restore(s);
+}
+
+//--------------------------------------------------
+//                     OUTPUT
+//--------------------------------------------------
+
+// Output one byte to UART
 void uart_putc(char c) {
-    volatile uint8_t *tx = (volatile uint8_t *)(UART0_BASE + UART_TX);
-    *tx = c;
+    uart_write(&c, 1);
 }
 
 // Output a null-terminated string to UART
 void uart_puts(const char *s) {
-    for (const char *p = s; *p; ++p) uart_putc(*p);
+    unsigned int len = 0;
+    while (s[len]) len++;
+    uart_write(s, len);
+}
+
+// Output an unsigned number in decimal
+void uart_putdec(uint64_t n) {
+    char num[21];
+    int i = 0;
+    do {
+        num[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) uart_putc(num[--i]);
+}
+
+// Output a 64-bit value as 0x-prefixed hex
+void uart_puthex(uint64_t n) {
+    uart_puts("0x");
+    for (int shift = 60; shift >= 0; shift -= 4)
+        uart_putc("0123456789abcdef"[(n >> shift) & 0xf]);
 }
 
-// Read one byte from UART receive register (blocking)
+// Ring-sized pieces, so interrupts are not held off for the whole buffer
+void outbuf_print(struct outbuf *o) {
+    for (unsigned int off = 0; off < o->len; off += TX_RING_SIZE) {
+        unsigned int n = o->len - off;
+        uart_write(o->buf + off, n < TX_RING_SIZE ? n : TX_RING_SIZE);
+    }
+    if (o->truncated) uart_puts("[output truncated]\n");
+}
+
+// Read one byte from UART (blocking).
+// With interrupts live the caller sleeps on rx_wait until the RX ring
+// has data; before uart_init it falls back to polling the data-ready bit.
 char uart_getc(void) {
-    volatile uint8_t *lsr = (volatile uint8_t *)(UART0_BASE + UART_LSR);
-    volatile uint8_t *rx  = (volatile uint8_t *)(UART0_BASE + UART_RX);
-    while (!(*lsr & UART_LSR_DR)) ; // Wait until data ready
-    return *rx;
+    if (!uart_irq_mode) {
+        while (!(*uart_reg(UART_LSR) & UART_LSR_DR)) cpu_relax(); // Wait until data ready
+        return *uart_reg(UART_RX);
+    }
+
+    char c;
+    int slept = 0;
+    while (!rx_pop(&c)) {
+        wait_event(&rx_wait, rx_head != rx_tail);
+        slept = 1;
+    }
+    if (slept) latency_since(LAT_WAKEUP, rx_arrival);
+    return c;
+}
+
+int uart_trygetc(char *c) {
+    if (!uart_irq_mode) {
+        if (!(*uart_reg(UART_LSR) & UART_LSR_DR)) return 0;
+        *c = *uart_reg(UART_RX);
+        return 1;
+    }
+    return rx_pop(c);
 }
 
 //--------------------------------------------------
@@ -61,4 +388,4 @@ void strin(char dest[], int len) {
                 }
         }
     }
-}
\ No newline at end of file
+}
@@ -1,8 +1,35 @@
 #ifndef IO_H
 #define IO_H
 
+#include "stdint.h"
+
+void uart_init(void);
+void uart_flush(void);
+void uart_force_sync(void);
 void uart_putc(char c);
 void uart_puts(const char *s);
+void uart_putdec(uint64_t n);
+void uart_puthex(uint64_t n);
+char uart_getc(void);
+int uart_trygetc(char *c);      // 1 and the byte if one is waiting, else 0
 void strin(char dest[], int len);
 
+// Output capture: while a thread has one attached, everything it prints
+// is appended to the buffer instead of the UART, so tasks running side
+// by side do not interleave. Text past size is dropped (truncated set).
+struct outbuf {
+    char *buf;
+    unsigned int size;
+    unsigned int len;
+    int truncated;
+};
+
+void outbuf_init(struct outbuf *o, char *buf, unsigned int size);
+
+// Attach o to the calling thread (NULL detaches)
+void uart_capture(struct outbuf *o);
+
+// Print a captured buffer to the UART
+void outbuf_print(struct outbuf *o);
+
 #endif
\ No newline at end of file
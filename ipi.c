@@ -0,0 +1,75 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+#include "trap.h"
+#include "sbi.h"
+#include "cpu.h"
+#include "ipi.h"
+
+//--------------------------------------------------
+//            INTER-PROCESSOR INTERRUPTS
+//--------------------------------------------------
+// Senders OR a message bit into the target's cpu->ipi_pending and raise
+// its supervisor software interrupt through SBI. The target clears SSIP
+// before swapping the pending word to zero, so no message is lost.
+
+static ipi_handler_t ipi_handlers[IPI_MAX];
+
+static void ipi_nop(void) { }
+
+void ipi_register(unsigned int msg, ipi_handler_t fn) {
+    if (msg < IPI_MAX) ipi_handlers[msg] = fn;
+}
+
+void ipi_poll(void) {
+    struct cpu *c = this_cpu();
+
+    csr_clear(sip, SIE_SSIE);
+    uint64_t pending = atomic_swap64(&c->ipi_pending, 0);
+    if (!pending) return;
+
+    c->ipi_received++;
+    for (unsigned int msg = 0; msg < IPI_MAX; msg++) {
+        if ((pending & (1UL << msg)) && ipi_handlers[msg])
+            ipi_handlers[msg]();
+    }
+}
+
+static void ipi_irq(struct trap_frame *tf) {
+    (void)tf;
+    ipi_poll();
+}
+
+void ipi_send_mask(uint64_t cpumask, unsigned int msg) {
+    uint64_t self = 1UL << this_cpu()->id;
+    uint64_t hart_mask = 0;
+
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (!(cpumask & (1UL << i)) || !cpus[i].online) continue;
+        atomic_fetch_or64(&cpus[i].ipi_pending, 1UL << msg);
+        if (i != this_cpu()->id) hart_mask |= 1UL << cpus[i].hartid;
+    }
+
+    // Local delivery needs no firmware: S-mode may raise its own SSIP
+    if (cpumask & self) csr_set(sip, SIE_SSIE);
+    if (hart_mask) sbi_send_ipi(hart_mask, 0);
+}
+
+void ipi_send(unsigned int cpu, unsigned int msg) {
+    ipi_send_mask(1UL << cpu, msg);
+}
+
+//--------------------------------------------------
+//                     SETUP
+//--------------------------------------------------
+
+void ipi_init(void) {
+    ipi_register(IPI_WAKEUP, ipi_nop);
+    trap_set_interrupt_handler(IRQ_S_SOFT, ipi_irq);
+    ipi_init_hart();
+}
+
+void ipi_init_hart(void) {
+    csr_clear(sip, SIE_SSIE);
+    csr_set(sie, SIE_SSIE);
+}
@@ -0,0 +1,27 @@
+#ifndef IPI_H
+#define IPI_H
+
+#include "stdint.h"
+
+// IPI message types (bit numbers in cpu->ipi_pending)
+#define IPI_WAKEUP     0        // Just kick the hart out of wfi
+#define IPI_TLB_FLUSH  1        // Process batched TLB shootdown requests
+#define IPI_RESCHED    2        // A woken thread was queued on this hart
+#define IPI_MAX        8
+
+typedef void (*ipi_handler_t)(void);
+
+void ipi_init(void);
+void ipi_init_hart(void);
+void ipi_register(unsigned int msg, ipi_handler_t fn);
+
+// Post a message to one hart / every hart in a logical-id mask.
+// A mask is delivered with a single SBI call.
+void ipi_send(unsigned int cpu, unsigned int msg);
+void ipi_send_mask(uint64_t cpumask, unsigned int msg);
+
+// Handle this hart's pending messages without waiting for the trap
+// (used while spinning on another hart with interrupts off)
+void ipi_poll(void);
+
+#endif
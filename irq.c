@@ -0,0 +1,149 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "trap.h"
+#include "plic.h"
+#include "aia.h"
+#include "cpu.h"
+#include "latency.h"
+#include "io.h"
+#include "irq.h"
+
+//--------------------------------------------------
+//             DEVICE INTERRUPT TABLE
+//--------------------------------------------------
+
+struct irq_desc {
+    irq_handler_t handler;
+    void *arg;
+    const char *name;
+    uint64_t affinity;          // Logical ids of harts whose PLIC context is enabled
+    uint64_t count[MAX_HARTS];  // Handled on each hart (only that hart writes)
+};
+
+static struct irq_desc irq_table[IRQ_MAX];
+static const struct irq_chip *chip;
+
+int irq_register(unsigned int irq, const char *name, irq_handler_t fn, void *arg) {
+    if (irq == 0 || irq >= IRQ_MAX || irq_table[irq].handler) return -1;
+
+    irq_table[irq].handler = fn;
+    irq_table[irq].arg = arg;
+    irq_table[irq].name = name;
+
+    chip->setup(irq);
+    irq_table[irq].affinity = 0;
+    irq_set_affinity(irq, 1UL << this_cpu()->id);
+    return 0;
+}
+
+//--------------------------------------------------
+//                  IRQ AFFINITY
+//--------------------------------------------------
+// The backend may narrow the mask: the PLIC can signal several harts
+// (first claim wins), an APLIC MSI goes to exactly one.
+
+int irq_set_affinity(unsigned int irq, uint64_t mask) {
+    if (irq == 0 || irq >= IRQ_MAX || !irq_table[irq].handler) return -1;
+    mask &= cpu_online_mask();
+    if (!mask) return -1;
+
+    uint64_t s = intr_save();
+    irq_table[irq].affinity = chip->set_affinity(irq, irq_table[irq].affinity, mask);
+    intr_restore(s);
+    return 0;
+}
+
+uint64_t irq_get_affinity(unsigned int irq) {
+    if (irq == 0 || irq >= IRQ_MAX) return 0;
+    return irq_table[irq].affinity;
+}
+
+static void print_ids(uint64_t mask, int hart_ids) {
+    int first = 1;
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (!(mask & (1UL << i))) continue;
+        if (!first) uart_putc(',');
+        uart_putdec(hart_ids ? cpus[i].hartid : i);
+        first = 0;
+    }
+    if (first) uart_putc('-');
+}
+
+// Print a logical-id mask as the logical ids irqaff takes ("0,2"),
+// followed by the hart ids when they differ ("0,2 (hart 1,5)")
+void irq_print_mask(uint64_t mask) {
+    print_ids(mask, 0);
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if ((mask & (1UL << i)) && cpus[i].hartid != i) {
+            uart_puts(" (hart ");
+            print_ids(mask, 1);
+            uart_putc(')');
+            return;
+        }
+    }
+}
+
+// irqs command: one row per registered IRQ, one count column per online hart
+void irq_print_stats(void) {
+    uint64_t online = cpu_online_mask();
+
+    uart_puts("IRQ  NAME      AFFINITY");
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (!(online & (1UL << i))) continue;
+        uart_puts("  HART");
+        uart_putdec(cpus[i].hartid);
+    }
+    uart_puts("\n");
+
+    for (unsigned int irq = 1; irq < IRQ_MAX; irq++) {
+        struct irq_desc *d = &irq_table[irq];
+        if (!d->handler) continue;
+
+        uart_putdec(irq);
+        uart_puts("   ");
+        uart_puts(d->name ? d->name : "?");
+        uart_puts("     ");
+        irq_print_mask(d->affinity);
+        for (unsigned int i = 0; i < MAX_HARTS; i++) {
+            if (!(online & (1UL << i))) continue;
+            uart_puts("  ");
+            uart_putdec(d->count[i]);
+        }
+        uart_puts("\n");
+    }
+}
+
+//--------------------------------------------------
+//          EXTERNAL INTERRUPT (SEI) HANDLER
+//--------------------------------------------------
+
+// Drain every pending source before returning so back-to-back
+// interrupts are handled without another trap round trip.
+static void irq_external(struct trap_frame *tf) {
+    (void)tf;
+    unsigned int irq;
+
+    while ((irq = chip->claim()) != 0) {
+        latency_since(LAT_IRQ, this_cpu()->irq_entry);
+        if (irq < IRQ_MAX && irq_table[irq].handler) {
+            irq_table[irq].count[this_cpu()->id]++;
+            irq_table[irq].handler(irq, irq_table[irq].arg);
+        }
+        chip->complete(irq);
+    }
+}
+
+void irq_init(void) {
+    chip = aia_probe() ? &aia_chip : &plic_chip;
+    uart_puts("IRQ: ");
+    uart_puts(chip->name);
+    uart_puts("\n");
+
+    trap_set_interrupt_handler(IRQ_S_EXT, irq_external);
+    irq_init_hart();
+}
+
+void irq_init_hart(void) {
+    chip->init_hart();
+    csr_set(sie, SIE_SEIE);
+}
@@ -0,0 +1,43 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include "stdint.h"
+
+#define IRQ_MAX 96
+
+typedef void (*irq_handler_t)(unsigned int irq, void *arg);
+
+// Interrupt controller backend (plic.c, aia.c)
+struct irq_chip {
+    const char *name;
+    void (*init_hart)(void);                // Per-hart setup, on the hart itself
+    void (*setup)(unsigned int irq);        // Configure a newly registered source
+    // Route irq to harts in mask (logical ids, all online), currently
+    // routed to old; returns the mask actually in effect
+    uint64_t (*set_affinity)(unsigned int irq, uint64_t old, uint64_t mask);
+    unsigned int (*claim)(void);            // Next pending IRQ on this hart, 0 if none
+    void (*complete)(unsigned int irq);
+};
+
+// Pick the interrupt controller (AIA if the device tree has one, else the
+// PLIC), install the external-interrupt trap handler and unmask SEIE
+// (irq_init_hart on secondary harts)
+void irq_init(void);
+void irq_init_hart(void);
+
+// Attach a device handler and enable the line at the controller, routed
+// to the calling hart. Returns 0 on success, -1 if the IRQ is out of
+// range or already taken.
+int irq_register(unsigned int irq, const char *name, irq_handler_t fn, void *arg);
+
+// Route an IRQ to the online harts in a logical-id mask.
+// Returns -1 if the IRQ is not registered or no hart in mask is online.
+int irq_set_affinity(unsigned int irq, uint64_t mask);
+uint64_t irq_get_affinity(unsigned int irq);
+
+// Per-IRQ, per-hart interrupt counts (irqs command)
+void irq_print_stats(void);
+// Logical ids of a mask (as irqaff takes them), plus hart ids if they differ
+void irq_print_mask(uint64_t mask);
+
+#endif
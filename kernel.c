@@ -5,9 +5,32 @@
 #include "fs.h"
 #include "cmd.h"
 #include "libstr.h"
+#include "trap.h"
+#include "irq.h"
+#include "cpu.h"
+#include "sbi.h"
+#include "timer.h"
+#include "clock.h"
+#include "fdt.h"
+#include "riscv.h"
+#include "ipi.h"
+#include "tlb.h"
+#include "smp.h"
+#include "latency.h"
+#include "thread.h"
+#include "async.h"
+#include "lock.h"
+#include "spin.h"
+#include "fpu.h"
+#include "wait.h"
+#include "ring.h"
+#include "work.h"
 
 // Forward declaration for recursive exec
-void run_command(char *input);
+int run_command(char *input);
+
+// Exit status of a task stopped by kill (128 + SIGKILL, as in sh)
+#define STATUS_KILLED 137
 
 //==================================================
 //            SYSTEM SHUTDOWN (SBI CALL)
@@ -37,38 +60,47 @@ static void sbi_shutdown(void) {
 //            PROGRAM EXECUTION (SCRIPTS)
 //==================================================
 
-// Maximum nesting depth for exec calls (prevent infinite recursion)
-static int exec_depth = 0;
+// Maximum nesting depth for exec calls (prevent infinite recursion);
+// the depth is counted per thread, so background jobs nest independently
 #define MAX_EXEC_DEPTH 4
 
-// Execute a script file - runs each line as a command
-static void exec_script(const char *path) {
+// Execute a script file - runs each line as a command.
+// Returns the status of the last command run.
+static int exec_script(const char *path) {
+    struct thread *self = thread_current();
+
     // Check recursion depth
-    if (exec_depth >= MAX_EXEC_DEPTH) {
+    if (self->exec_depth >= MAX_EXEC_DEPTH) {
         uart_puts("Error: Maximum script nesting depth reached.\n");
-        return;
+        return 1;
     }
 
-    // Get the executable content
-    const char *content = fs_get_executable(path);
-    if (!content) return;  // Error already printed
+    // Get a private copy of the script
+    char content[FS_CONTENT_SIZE];
+    if (!fs_get_executable(path, content)) return 1;  // Error already printed
 
     uart_puts("--- Executing: ");
     uart_puts(path);
     uart_puts(" ---\n");
 
-    exec_depth++;
+    self->exec_depth++;
 
     // Parse and execute each line
     // Commands are separated by newlines or semicolons
     char cmd_buffer[100];
     int cmd_idx = 0;
+    int status = 0;
 
     for (const char *p = content; ; p++) {
         char c = *p;
 
         // End of command: newline, semicolon, or end of content
         if (c == '\n' || c == ';' || c == '\0') {
+            // Killed: stop between commands
+            if (thread_killed()) {
+                status = STATUS_KILLED;
+                break;
+            }
             cmd_buffer[cmd_idx] = '\0';
 
             // Skip empty lines and whitespace-only lines
@@ -80,7 +112,7 @@ static void exec_script(const char *path) {
                 uart_puts("> ");
                 uart_puts(cmd);
                 uart_puts("\n");
-                run_command(cmd);
+                status = run_command(cmd);
             }
 
             cmd_idx = 0;  // Reset for next command
@@ -94,11 +126,12 @@ static void exec_script(const char *path) {
         }
     }
 
-    exec_depth--;
+    self->exec_depth--;
 
     uart_puts("--- Finished: ");
     uart_puts(path);
     uart_puts(" ---\n");
+    return status;
 }
 
 //==================================================
@@ -129,16 +162,605 @@ static int parse_perm(const char *str, unsigned int *out) {
     return 1;
 }
 
+// Parse an unsigned decimal (or 0x-prefixed hex) number; stops at end
+// of string or a space. Fails if the value does not fit in 64 bits.
+static int parse_uint(const char *str, uint64_t *out) {
+    if (!str || *str < '0' || *str > '9') return 0;
+    uint64_t n = 0, base = 10;
+    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        base = 16;
+        str += 2;
+        if (*str == '\0' || *str == ' ') return 0;    // Bare "0x"
+    }
+    for (;; str++) {
+        uint64_t d;
+        if (*str >= '0' && *str <= '9') d = *str - '0';
+        else if (base == 16 && *str >= 'a' && *str <= 'f') d = *str - 'a' + 10;
+        else if (base == 16 && *str >= 'A' && *str <= 'F') d = *str - 'A' + 10;
+        else break;
+        if (n > (~0UL - d) / base) return 0;            // Overflow
+        n = n * base + d;
+    }
+    if (*str != '\0' && *str != ' ') return 0;
+    *out = n;
+    return 1;
+}
+
+// Same, with an optional leading '-'
+static int parse_int(const char *str, int64_t *out) {
+    int neg = str && *str == '-';
+    uint64_t n;
+    if (!parse_uint(neg ? str + 1 : str, &n)) return 0;
+    if (n > (1UL << 63) - 1 + neg) return 0;           // Out of int64 range
+    *out = neg ? (int64_t)(0 - n) : (int64_t)n;
+    return 1;
+}
+
+// Skip the word at str and the spaces after it
+static char *next_arg(char *str) {
+    while (*str && *str != ' ') str++;
+    while (*str == ' ') str++;
+    return str;
+}
+
+// irqaff <irq> [mask]: show or set which harts an IRQ is routed to
+static void cmd_irqaff(char *args) {
+    uint64_t irq, mask;
+    if (!parse_uint(args, &irq)) {
+        uart_puts("Usage: irqaff <irq> [hart mask]\n");
+        return;
+    }
+    if (irq >= IRQ_MAX) {
+        uart_puts("irqaff: bad IRQ\n");
+        return;
+    }
+    while (*args && *args != ' ') args++;
+    while (*args == ' ') args++;
+
+    if (*args != '\0') {
+        if (!parse_uint(args, &mask)) {
+            uart_puts("Usage: irqaff <irq> [hart mask]\n");
+            return;
+        }
+        if (irq_set_affinity(irq, mask) != 0) {
+            uart_puts("irqaff: bad IRQ or no online hart in mask\n");
+            return;
+        }
+    }
+    uart_puts("IRQ ");
+    uart_putdec(irq);
+    uart_puts(" -> cpu ");
+    irq_print_mask(irq_get_affinity(irq));
+    uart_puts("\n");
+}
+
+//==================================================
+//               TIMING BUILTINS
+//==================================================
+
+// Print a nanosecond count as "<ms>.<3 digits> ms"
+static void print_ms(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    uart_putdec(us / 1000);
+    uart_putc('.');
+    uint64_t frac = us % 1000;
+    if (frac < 100) uart_putc('0');
+    if (frac < 10) uart_putc('0');
+    uart_putdec(frac);
+    uart_puts(" ms");
+}
+
+// uptime: time since boot
+static void cmd_uptime(void) {
+    uint64_t ns = clock_uptime_ns();
+    uint64_t secs = ns / 1000000000UL;
+
+    uart_puts("up ");
+    uart_putdec(secs / 3600);
+    uart_putc(':');
+    uint64_t mins = (secs / 60) % 60;
+    if (mins < 10) uart_putc('0');
+    uart_putdec(mins);
+    uart_putc(':');
+    if (secs % 60 < 10) uart_putc('0');
+    uart_putdec(secs % 60);
+    uart_puts(" (");
+    print_ms(ns);
+    uart_puts(")\n");
+}
+
+// time <command>: wall time, cycles and retired instructions of one command
+static int cmd_time(char *command) {
+    uint64_t t0 = clock_now();
+    uint64_t c0 = rdcycle();
+    uint64_t i0 = rdinstret();
+
+    int status = run_command(command);
+
+    uint64_t i1 = rdinstret();
+    uint64_t c1 = rdcycle();
+    uint64_t t1 = clock_now();
+
+    uart_puts("real    ");
+    print_ms(clock_to_ns(t1 - t0));
+    uart_puts("\ncycles  ");
+    uart_putdec(c1 - c0);
+    uart_puts("\ninstret ");
+    uart_putdec(i1 - i0);
+    uart_puts("\n");
+    return status;
+}
+
+//==================================================
+//                BACKGROUND JOBS
+//==================================================
+// "cmd &" runs cmd on a thread of its own and returns to the prompt at
+// once. Jobs are numbered from 1; a finished job stays in the table,
+// holding its thread's slot and exit status, until it is reported by
+// the prompt, jobs or wait. Any thread may start jobs (a script can
+// use &), so the table has a lock; a slot being waited for is marked
+// busy so only one thread joins it.
+
+#define MAX_JOBS 8
+#define JOB_CMD_LEN 100
+
+struct job {
+    int id;                     // 1..MAX_JOBS, 0 for a free slot
+    int tid;
+    int busy;                   // Being started or waited for
+    char cmd[JOB_CMD_LEN];      // As typed, for jobs
+    char line[JOB_CMD_LEN];     // Working copy the job's parser splits up
+};
+
+static struct job jobs[MAX_JOBS];
+static spinlock_t job_lock = SPINLOCK_INIT;
+
+static int job_main(void *arg) {
+    struct job *j = arg;
+    int status = run_command(j->line);
+    return thread_killed() ? STATUS_KILLED : status;
+}
+
+static void job_print_head(struct job *j) {
+    uart_puts("[");
+    uart_putdec(j->id);
+    uart_puts("] ");
+}
+
+// Start cmd as a background job
+static int job_start(const char *cmd) {
+    struct job *j = NULL;
+    uint64_t s = spin_lock_irqsave(&job_lock);
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].id == 0) {
+            j = &jobs[i];
+            j->id = i + 1;
+            j->busy = 1;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&job_lock, s);
+    if (!j) {
+        uart_puts("Error: Too many background jobs.\n");
+        return 1;
+    }
+
+    int i = 0;
+    for (; cmd[i] && i < JOB_CMD_LEN - 1; i++) j->cmd[i] = j->line[i] = cmd[i];
+    j->cmd[i] = j->line[i] = '\0';
+
+    char name[] = "job0";
+    name[3] = '0' + j->id;
+    int tid = thread_create(name, job_main, j);
+    if (tid < 0) {
+        j->id = 0;
+        uart_puts("Error: No free thread for the job.\n");
+        return 1;
+    }
+    j->tid = tid;
+    job_print_head(j);
+    uart_putdec(tid);
+    uart_puts("\n");
+    mb();
+    j->busy = 0;
+    return 0;
+}
+
+// Claim a job for reaping: id 0 takes any job, finished ones only if
+// done_only. Returns NULL if there is none.
+static struct job *job_claim(int id, int done_only) {
+    struct job *found = NULL;
+    uint64_t s = spin_lock_irqsave(&job_lock);
+    for (int i = 0; i < MAX_JOBS && !found; i++) {
+        struct job *j = &jobs[i];
+        if (j->id == 0 || j->busy || (id && j->id != id)) continue;
+        if (done_only && thread_done(j->tid) != 1) continue;
+        j->busy = 1;
+        found = j;
+    }
+    spin_unlock_irqrestore(&job_lock, s);
+    return found;
+}
+
+// Join a claimed job, report how it ended and free its slot
+static int job_reap(struct job *j) {
+    int status = 1;
+    thread_join(j->tid, &status);
+
+    job_print_head(j);
+    if (status == STATUS_KILLED) {
+        uart_puts("Killed    ");
+    } else {
+        uart_puts("Done ");
+        uart_putdec(status);
+        uart_puts("    ");
+    }
+    uart_puts(j->cmd);
+    uart_puts("\n");
+
+    j->id = 0;
+    return status;
+}
+
+// Report jobs that finished since the last prompt
+static void job_notify(void) {
+    struct job *j;
+    while ((j = job_claim(0, 1)) != NULL) job_reap(j);
+}
+
+// jobs: list running jobs, then report finished ones
+static void cmd_jobs(void) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        struct job *j = &jobs[i];
+        if (j->id == 0 || j->busy || thread_done(j->tid) == 1) continue;
+        job_print_head(j);
+        uart_puts("Running   tid ");
+        uart_putdec(j->tid);
+        uart_puts("  ");
+        uart_puts(j->cmd);
+        uart_puts("\n");
+    }
+    job_notify();
+}
+
+// wait [job]: block until one job (or every job) has finished; returns
+// the exit status of the (last) job waited for
+static int cmd_wait(char *args) {
+    uint64_t id = 0;
+    if (*args != '\0' && (!parse_uint(args, &id) || id == 0)) {
+        uart_puts("Usage: wait [job]\n");
+        return 1;
+    }
+
+    struct job *j = job_claim(id, 0);
+    if (!j) {
+        if (!id) return 0;
+        uart_puts("wait: no such job\n");
+        return 127;
+    }
+    int status;
+    do {
+        status = job_reap(j);
+    } while (!id && (j = job_claim(0, 0)) != NULL);
+    return status;
+}
+
+// kill <job>: ask a job to stop; it ends at its next check point (between
+// script lines, or out of sleep) and is reported as Killed
+static int cmd_kill(char *args) {
+    uint64_t id;
+    if (!parse_uint(args, &id) || id == 0 || id > MAX_JOBS) {
+        uart_puts("Usage: kill <job>\n");
+        return 1;
+    }
+    // Under job_lock, so the slot cannot be reaped or reused meanwhile
+    struct job *j = &jobs[id - 1];
+    uint64_t s = spin_lock_irqsave(&job_lock);
+    int ret = j->id == 0 || j->busy || thread_kill(j->tid) != 0;
+    spin_unlock_irqrestore(&job_lock, s);
+    if (ret) {
+        uart_puts("kill: no such running job\n");
+        return 1;
+    }
+    return 0;
+}
+
+//==================================================
+//              PARALLEL SCRIPT BATCHES
+//==================================================
+// parallel a b c: each script runs on its own thread, pinned round-robin
+// to the online harts, with its output captured so the scripts do not
+// interleave. When all have finished, each script's output is printed
+// in order, followed by per-script and total times. The buffers are
+// static, so only one batch runs at a time.
+
+#define MAX_PARALLEL 8
+#define PARALLEL_OUT_SIZE 2048
+
+struct ptask {
+    char path[64];
+    struct outbuf out;
+    unsigned int cpu;
+    int tid;
+    int status;
+    uint64_t elapsed;           // Clock ticks
+};
+
+static struct ptask ptasks[MAX_PARALLEL];
+static char ptask_out[MAX_PARALLEL][PARALLEL_OUT_SIZE];
+static struct mutex parallel_lock = MUTEX_INIT;
+
+static int ptask_main(void *arg) {
+    struct ptask *p = arg;
+    uart_capture(&p->out);
+    uint64_t start = clock_now();
+    p->status = exec_script(p->path);
+    p->elapsed = clock_now() - start;
+    uart_capture(NULL);
+    return p->status;
+}
+
+// Returns the last non-zero script status, or 0
+static int cmd_parallel(char *args) {
+    if (*args == '\0') {
+        uart_puts("Usage: parallel <script>...\n");
+        return 1;
+    }
+    if (!mutex_trylock(&parallel_lock)) {
+        uart_puts("parallel: another batch is running\n");
+        return 1;
+    }
+
+    // Split the arguments into script paths
+    int n = 0;
+    while (*args != '\0' && n < MAX_PARALLEL) {
+        struct ptask *p = &ptasks[n];
+        int len = 0;
+        while (*args && *args != ' ' && len < (int)sizeof(p->path) - 1)
+            p->path[len++] = *args++;
+        p->path[len] = '\0';
+        while (*args && *args != ' ') args++;
+        while (*args == ' ') args++;
+        n++;
+    }
+    if (*args != '\0') uart_puts("parallel: too many scripts, the rest are ignored\n");
+
+    // Deal the scripts out to the online harts in turn
+    uint64_t online = cpu_online_mask();
+    unsigned int cpu = 0;
+    uint64_t start = clock_now();
+    for (int i = 0; i < n; i++) {
+        struct ptask *p = &ptasks[i];
+        while (!(online & (1UL << cpu))) cpu = (cpu + 1) % MAX_HARTS;
+        p->cpu = cpu;
+        p->status = 1;
+        p->elapsed = 0;
+        outbuf_init(&p->out, ptask_out[i], PARALLEL_OUT_SIZE);
+
+        char name[] = "par0";
+        name[3] = '0' + i;
+        p->tid = thread_create_on(name, ptask_main, p, cpu);
+        if (p->tid < 0) {
+            uart_puts("parallel: no free thread for ");
+            uart_puts(p->path);
+            uart_puts("\n");
+        }
+        cpu = (cpu + 1) % MAX_HARTS;
+    }
+
+    for (int i = 0; i < n; i++)
+        if (ptasks[i].tid >= 0) thread_join(ptasks[i].tid, NULL);
+    uint64_t total = clock_now() - start;
+
+    int status = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) {
+        struct ptask *p = &ptasks[i];
+        if (p->tid < 0) continue;
+        uart_puts("=== ");
+        uart_puts(p->path);
+        uart_puts(" ===\n");
+        outbuf_print(&p->out);
+    }
+
+    uart_puts("HART  STATUS  TIME          SCRIPT\n");
+    for (int i = 0; i < n; i++) {
+        struct ptask *p = &ptasks[i];
+        if (p->tid < 0) continue;
+        uart_putdec(cpus[p->cpu].hartid);
+        uart_puts("     ");
+        uart_putdec(p->status);
+        uart_puts("       ");
+        print_ms(clock_to_ns(p->elapsed));
+        uart_puts("  ");
+        uart_puts(p->path);
+        uart_puts("\n");
+        sum += p->elapsed;
+        if (p->status) status = p->status;
+    }
+    uart_puts("Total: ");
+    print_ms(clock_to_ns(total));
+    uart_puts(" wall, ");
+    print_ms(clock_to_ns(sum));
+    uart_puts(" summed\n");
+
+    mutex_unlock(&parallel_lock);
+    return status;
+}
+
+//==================================================
+//              SCHEDULING BUILTINS
+//==================================================
+
+// Priority the shell reads its input at; FIFO tasks above it can still
+// hold up the echo
+#define SHELL_RT_PRIO 50
+
+// nice <n> <command>: run command as a fair task at nice n (-20..19;
+// lower gets longer slices), then go back to the shell's own class
+static int cmd_nice(char *args) {
+    int64_t n;
+    char *command = next_arg(args);
+    if (!parse_int(args, &n) || n < NICE_MIN || n > NICE_MAX || *command == '\0') {
+        uart_puts("Usage: nice <-20..19> <command>\n");
+        return 1;
+    }
+
+    int tid = thread_current()->tid;
+    struct sched_attr old, attr = { SCHED_FAIR, (int)n, 0, 0, 0, 0 };
+    thread_getsched(tid, &old);
+    if (thread_setsched(tid, &attr) != 0) {
+        uart_puts("nice: cannot change the scheduling class\n");
+        return 1;
+    }
+    int status = run_command(command);
+    // A deadline caller gave up its reservation and may not get it back
+    if (thread_setsched(tid, &old) != 0)
+        uart_puts("nice: could not restore the previous class, staying fair\n");
+    return status;
+}
+
+static void print_sched_attr(int tid, const struct sched_attr *a) {
+    uart_puts("tid ");
+    uart_putdec(tid);
+    if (a->policy == SCHED_DEADLINE) {
+        uart_puts(": deadline, runtime ");
+        uart_putdec(a->runtime_ms);
+        uart_puts(" ms, deadline ");
+        uart_putdec(a->deadline_ms);
+        uart_puts(" ms, period ");
+        uart_putdec(a->period_ms);
+        uart_puts(" ms\n");
+    } else if (a->policy == SCHED_FIFO) {
+        uart_puts(": fifo, priority ");
+        uart_putdec(a->prio);
+        uart_puts("\n");
+    } else {
+        uart_puts(": fair, nice ");
+        if (a->nice < 0) uart_puts("-");
+        uart_putdec(a->nice < 0 ? -a->nice : a->nice);
+        uart_puts("\n");
+    }
+}
+
+// chrt <tid>: show a task's class
+// chrt -f <prio> <tid> | -o <tid> | -d <runtime> <deadline> <period> <tid>:
+// make it FIFO (1..99), fair (nice 0) or deadline (times in ms)
+static int cmd_chrt(char *args) {
+    struct sched_attr attr = { SCHED_FAIR, 0, 0, 0, 0, 0 };
+    uint64_t tid, prio;
+    int set = 1, ok = 1;
+
+    if (strncmp(args, "-f ", 3) == 0) {
+        attr.policy = SCHED_FIFO;
+        args = next_arg(args);
+        ok = parse_uint(args, &prio) && prio >= RT_PRIO_MIN && prio <= RT_PRIO_MAX;
+        attr.prio = (int)prio;
+        args = next_arg(args);
+    } else if (strncmp(args, "-o ", 3) == 0) {
+        args = next_arg(args);
+    } else if (strncmp(args, "-d ", 3) == 0) {
+        attr.policy = SCHED_DEADLINE;
+        args = next_arg(args);
+        ok = parse_uint(args, &attr.runtime_ms);
+        args = next_arg(args);
+        ok = ok && parse_uint(args, &attr.deadline_ms);
+        args = next_arg(args);
+        ok = ok && parse_uint(args, &attr.period_ms);
+        args = next_arg(args);
+    } else {
+        set = 0;
+    }
+    if (!ok || !parse_uint(args, &tid) || tid > 0x7fffffff || *next_arg(args) != '\0') {
+        uart_puts("Usage: chrt [-f <prio> | -o | -d <runtime> <deadline> <period>] <tid>\n");
+        return 1;
+    }
+
+    if (!set) {
+        if (thread_getsched((int)tid, &attr) != 0) {
+            uart_puts("chrt: no such task\n");
+            return 1;
+        }
+        print_sched_attr((int)tid, &attr);
+        return 0;
+    }
+
+    int ret = thread_setsched((int)tid, &attr);
+    if (ret == -2) {
+        uart_puts("chrt: not enough deadline bandwidth left\n");
+        return 1;
+    }
+    if (ret != 0) {
+        uart_puts(attr.policy == SCHED_DEADLINE
+                  ? "chrt: no such task, or not runtime <= deadline <= period\n"
+                  : "chrt: no such task\n");
+        return 1;
+    }
+    return 0;
+}
+
+#define TOP_INTERVAL_MS 1000
+#define TOP_POLL_MS 50          // How soon a keypress ends top
+
+// top [ms]: redraw per-hart and per-task CPU use every ms milliseconds
+// until a key is pressed
+static int cmd_top(char *args) {
+    uint64_t ms = TOP_INTERVAL_MS;
+    if (*args != '\0' && (!parse_uint(args, &ms) || ms == 0)) {
+        uart_puts("Usage: top [ms]\n");
+        return 1;
+    }
+    // The keypress check reads the UART input ring, which has a single
+    // consumer: only the foreground shell (thread 0, not captured) may poll it
+    struct thread *self = thread_current();
+    if (self->tid != 0 || self->out) {
+        uart_puts("top: only runs in the foreground shell\n");
+        return 1;
+    }
+
+    // The first frame covers the time since the last top (or boot)
+    char key;
+    for (;;) {
+        uart_puts("\033[H\033[2J");    // Home and clear the screen
+        thread_top();
+        uart_puts("\nEvery ");
+        uart_putdec(ms);
+        uart_puts(" ms; press any key to quit\n");
+        for (uint64_t waited = 0; waited < ms; waited += TOP_POLL_MS) {
+            if (uart_trygetc(&key)) return 0;
+            if (thread_killed()) return STATUS_KILLED;
+            timer_sleep(TOP_POLL_MS);
+        }
+    }
+}
+
 //==================================================
 //               COMMAND PARSER / SHELL
 //==================================================
 
-// Parse input string and run appropriate command
-void run_command(char *input) {
+// Parse input string and run appropriate command.
+// Returns the exit status: 0 on success, 1 on a usage error, 127 for an
+// unknown command, STATUS_KILLED if the task was killed.
+int run_command(char *input) {
     while (*input == ' ') input++; // Skip leading spaces
 
+    // Trailing '&': run in the background as a job
+    int len = strlen(input);
+    while (len > 0 && input[len - 1] == ' ') len--;
+    if (len > 0 && input[len - 1] == '&') {
+        len--;
+        while (len > 0 && input[len - 1] == ' ') len--;
+        input[len] = '\0';
+        if (len == 0) {
+            uart_puts("Usage: <command> &\n");
+            return 1;
+        }
+        return job_start(input);
+    }
+
     if (strncmp(input, "exit", 4) == 0 && (input[4] == '\0' || input[4] == ' ')) {
         uart_puts("Shutting down...\n");
+        uart_flush();
         sbi_shutdown();
     }
     else if (strncmp(input, "help", 4) == 0 && (input[4] == '\0' || input[4] == ' ')) {
@@ -152,26 +774,26 @@ void run_command(char *input) {
     else if (strncmp(input, "mkdir", 5) == 0 && (input[5] == '\0' || input[5] == ' ')) {
         char *args = input + 5;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: mkdir <dirname>\n");
-            return;
+            return 1;
         }
         fs_mkdir(args);
     } 
     else if (strncmp(input, "rmdir", 5) == 0 && (input[5] == '\0' || input[5] == ' ')) {
         char *args = input + 5;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         fs_rmdir(args);
     }
     else if (strncmp(input, "touchro", 7) == 0 && (input[7] == '\0' || input[7] == ' ')) {
         char *args = input + 7;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: touchro <filename>\n");
-            return;
+            return 1;
         }
         // Create read-only file (permission 4 = read only)
         fs_touch_with_perms(args, PERM_READ);
@@ -179,10 +801,10 @@ void run_command(char *input) {
     else if (strncmp(input, "touch", 5) == 0 && (input[5] == '\0' || input[5] == ' ')) {
         char *args = input + 5;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: touch <filename>\n");
-            return;
+            return 1;
         }
         fs_touch(args);
     }
@@ -193,7 +815,7 @@ void run_command(char *input) {
         } else {
             char *args = input + 2;
             while (*args == ' ') args++;
-            if (!validate_path(args)) return;
+            if (!validate_path(args)) return 1;
             fs_rm(args);
         }
     }
@@ -213,10 +835,10 @@ void run_command(char *input) {
     else if (strncmp(input, "cd", 2) == 0 && (input[2] == '\0' || input[2] == ' ')) {
         char *args = input + 2;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: cd <dirname>\n");
-            return;
+            return 1;
         }
         fs_cd(args);
     } 
@@ -238,9 +860,9 @@ void run_command(char *input) {
             unsigned int perms;
             if (!parse_perm(space, &perms)) {
                 uart_puts("Invalid permission! Use 0-7.\n");
-                return;
+                return 1;
             }
-            if (!validate_path(args)) return;
+            if (!validate_path(args)) return 1;
             fs_chmod(args, perms);
         } else {
             uart_puts("Usage: chmod <path> <perms>\n");
@@ -250,7 +872,7 @@ void run_command(char *input) {
     else if (strncmp(input, "stat", 4) == 0 && (input[4] == '\0' || input[4] == ' ')) {
         char *args = input + 4;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         fs_stat(args);
     }
     else if (strncmp(input, "write", 5) == 0 && (input[5] == ' ' || input[5] == '\0')) {
@@ -267,37 +889,167 @@ void run_command(char *input) {
             text = space;
         }
 
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: write <file> <text>\n");
-            return;
+            return 1;
         }
         fs_write(args, text);
     } 
     else if (strncmp(input, "cat", 3) == 0 && (input[3] == ' ' || input[3] == '\0')) {
         char *args = input + 3;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: cat <filename>\n");
-            return;
+            return 1;
         }
         fs_cat(args);
     }
     else if (strncmp(input, "exec", 4) == 0 && (input[4] == ' ' || input[4] == '\0')) {
         char *args = input + 4;
         while (*args == ' ') args++;
-        if (!validate_path(args)) return;
+        if (!validate_path(args)) return 1;
         if (*args == '\0') {
             uart_puts("Usage: exec <script_file>\n");
             uart_puts("  Runs commands from a file. File must have execute permission.\n");
-            return;
+            return 1;
         }
-        exec_script(args);
+        return exec_script(args);
+    }
+    else if (strncmp(input, "sleep", 5) == 0 && (input[5] == ' ' || input[5] == '\0')) {
+        char *args = input + 5;
+        while (*args == ' ') args++;
+        uint64_t ms;
+        if (!parse_uint(args, &ms)) {
+            uart_puts("Usage: sleep <ms>\n");
+            return 1;
+        }
+        timer_sleep(ms);
+    }
+    else if (strcmp(input, "timerbench") == 0) {
+        timer_bench();
+    }
+    else if (strcmp(input, "cpustat") == 0) {
+        cpu_print_stats();
+    }
+    else if (strcmp(input, "uptime") == 0) {
+        cmd_uptime();
+    }
+    else if (strcmp(input, "threads") == 0) {
+        thread_print();
+    }
+    else if (strcmp(input, "switchbench") == 0) {
+        thread_bench();
+    }
+    else if (strncmp(input, "ringbench", 9) == 0 && (input[9] == ' ' || input[9] == '\0')) {
+        char *args = input + 9;
+        while (*args == ' ') args++;
+        uint64_t n = 100000;
+        if (*args != '\0' && (!parse_uint(args, &n) || n == 0)) {
+            uart_puts("Usage: ringbench [messages]\n");
+            return 1;
+        }
+        ring_bench(n);
+    }
+    else if (strncmp(input, "asyncdemo", 9) == 0 && (input[9] == ' ' || input[9] == '\0')) {
+        char *args = input + 9;
+        while (*args == ' ') args++;
+        uint64_t n = 1000;
+        if (*args != '\0' && !parse_uint(args, &n)) {
+            uart_puts("Usage: asyncdemo [tasks]\n");
+            return 1;
+        }
+        if (n > ASYNC_MAX_TASKS) {
+            uart_puts("asyncdemo: at most ");
+            uart_putdec(ASYNC_MAX_TASKS);
+            uart_puts(" tasks\n");
+            return 1;
+        }
+        async_demo(n);
+    }
+    else if (strncmp(input, "timeslice", 9) == 0 && (input[9] == ' ' || input[9] == '\0')) {
+        char *args = input + 9;
+        while (*args == ' ') args++;
+        uint64_t ms;
+        if (*args != '\0') {
+            if (!parse_uint(args, &ms) || ms == 0) {
+                uart_puts("Usage: timeslice [ms]\n");
+                return 1;
+            }
+            thread_set_timeslice(ms);
+        }
+        uart_puts("Timeslice: ");
+        uart_putdec(thread_get_timeslice());
+        uart_puts(" ms\n");
+    }
+    else if (strcmp(input, "irqs") == 0) {
+        irq_print_stats();
+    }
+    else if (strncmp(input, "irqaff", 6) == 0 && (input[6] == ' ' || input[6] == '\0')) {
+        char *args = input + 6;
+        while (*args == ' ') args++;
+        cmd_irqaff(args);
+    }
+    else if (strcmp(input, "lockstat") == 0) {
+        lock_stats_print();
+    }
+    else if (strcmp(input, "lockstat reset") == 0) {
+        lock_stats_reset();
+    }
+    else if (strcmp(input, "latency") == 0) {
+        latency_print();
+    }
+    else if (strcmp(input, "latency reset") == 0) {
+        latency_reset();
+    }
+    else if (strncmp(input, "time", 4) == 0 && (input[4] == ' ' || input[4] == '\0')) {
+        char *args = input + 4;
+        while (*args == ' ') args++;
+        if (*args == '\0') {
+            uart_puts("Usage: time <command>\n");
+            return 1;
+        }
+        return cmd_time(args);
+    }
+    else if (strncmp(input, "parallel", 8) == 0 && (input[8] == ' ' || input[8] == '\0')) {
+        char *args = input + 8;
+        while (*args == ' ') args++;
+        return cmd_parallel(args);
+    }
+    else if (strcmp(input, "jobs") == 0) {
+        cmd_jobs();
+    }
+    else if (strncmp(input, "wait", 4) == 0 && (input[4] == ' ' || input[4] == '\0')) {
+        char *args = input + 4;
+        while (*args == ' ') args++;
+        return cmd_wait(args);
+    }
+    else if (strncmp(input, "kill", 4) == 0 && (input[4] == ' ' || input[4] == '\0')) {
+        char *args = input + 4;
+        while (*args == ' ') args++;
+        return cmd_kill(args);
+    }
+    else if (strncmp(input, "top", 3) == 0 && (input[3] == ' ' || input[3] == '\0')) {
+        char *args = input + 3;
+        while (*args == ' ') args++;
+        return cmd_top(args);
+    }
+    else if (strncmp(input, "nice", 4) == 0 && (input[4] == ' ' || input[4] == '\0')) {
+        char *args = input + 4;
+        while (*args == ' ') args++;
+        return cmd_nice(args);
+    }
+    else if (strncmp(input, "chrt", 4) == 0 && (input[4] == ' ' || input[4] == '\0')) {
+        char *args = input + 4;
+        while (*args == ' ') args++;
+        return cmd_chrt(args);
     }
     else if (*input != '\0') {
         uart_puts("Unknown command. Type 'help' for a list.\n");
+        return 127;
     }
+    return 0;
 }
 
 
@@ -306,16 +1058,52 @@ void run_command(char *input) {
 //                   KERNEL MAIN
 //==================================================
 
-void kmain(void) {
+// Boot hart entry; SBI passes our hart id in a0 and the device tree in a1
+// (boot.S leaves both intact)
+void kmain(uint64_t hartid, const void *dtb) {
+    fdt_init(dtb);
+    clock_init();
+    cpu_init(0, hartid);
+    thread_init();
+
     uart_puts("Please look at this window for input/output!\n");
     uart_puts("tiny-rv64-kernel: ready!\n");
 
+    sbi_init();
+    trap_init();
+    spin_init();
+    fpu_init();
+    irq_init();
+    ipi_init();
+    tlb_init();
+    timer_init();
+    cpu_set_online();           // Before the first irq_register targets it
+    uart_init();
+    smp_init();
+    work_start();
+    async_init();
     fs_init();
 
+    // The shell reads input as a FIFO task, so typing is echoed at once
+    // however busy the harts are; commands run in its own class. It is
+    // only ever raised: a shell already at a higher FIFO priority keeps
+    // it, and a deadline shell is left alone, since switching would give
+    // up its reservation at every prompt with no guarantee of getting it
+    // back.
     char buffer[100];
+    int tid = thread_current()->tid;
+    struct sched_attr rt = { SCHED_FIFO, 0, SHELL_RT_PRIO, 0, 0, 0 };
+    struct sched_attr own;
     for (;;) {
+        job_notify();
         uart_puts("> ");
+        thread_getsched(tid, &own);
+        int below = own.policy == SCHED_FAIR ||
+                    (own.policy == SCHED_FIFO && own.prio < SHELL_RT_PRIO);
+        int raised = below && thread_setsched(tid, &rt) == 0;
         strin(buffer, 100);
+        if (raised && thread_setsched(tid, &own) != 0)
+            uart_puts("shell: could not restore its scheduling class\n");
         run_command(buffer);
     }
 }
@@ -0,0 +1,136 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "clock.h"
+#include "cpu.h"
+#include "io.h"
+#include "latency.h"
+
+//--------------------------------------------------
+//                LATENCY HISTOGRAMS
+//--------------------------------------------------
+// Each hart keeps its own log2 histogram per source, so recording from
+// interrupt context is a few stores with no shared cache lines. The
+// `latency` command merges the harts when printing.
+
+struct lat_hist {
+    uint64_t count;
+    uint64_t sum;               // Nanoseconds
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[LAT_BUCKETS];
+};
+
+static struct lat_hist hists[MAX_HARTS][LAT_NR];
+
+static const char *lat_names[LAT_NR] = {
+    "timer   (deadline -> trap)",
+    "irq     (trap -> handler)",
+    "softirq (raise -> run)",
+    "wakeup  (event -> resume)",
+};
+
+static unsigned int log2_bucket(uint64_t ns) {
+    unsigned int b = 0;
+    while (ns > 1 && b < LAT_BUCKETS - 1) {
+        ns >>= 1;
+        b++;
+    }
+    return b;
+}
+
+void latency_record(unsigned int src, uint64_t ticks) {
+    if (src >= LAT_NR) return;
+    uint64_t ns = clock_to_ns(ticks);
+
+    uint64_t s = intr_save();
+    struct lat_hist *h = &hists[this_cpu()->id][src];
+    if (h->count == 0 || ns < h->min) h->min = ns;
+    if (ns > h->max) h->max = ns;
+    h->count++;
+    h->sum += ns;
+    h->buckets[log2_bucket(ns)]++;
+    intr_restore(s);
+}
+
+void latency_since(unsigned int src, uint64_t stamp) {
+    uint64_t now = clock_now();
+    latency_record(src, now > stamp ? now - stamp : 0);
+}
+
+void latency_reset(void) {
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        uint64_t s = intr_save();
+        for (unsigned int src = 0; src < LAT_NR; src++) {
+            struct lat_hist *h = &hists[i][src];
+            h->count = h->sum = h->min = h->max = 0;
+            for (unsigned int b = 0; b < LAT_BUCKETS; b++) h->buckets[b] = 0;
+        }
+        intr_restore(s);
+    }
+}
+
+// Print a nanosecond value with a unit that keeps it short
+static void print_ns(uint64_t ns) {
+    if (ns >= 10000000) {
+        uart_putdec(ns / 1000000);
+        uart_puts("ms");
+    } else if (ns >= 10000) {
+        uart_putdec(ns / 1000);
+        uart_puts("us");
+    } else {
+        uart_putdec(ns);
+        uart_puts("ns");
+    }
+}
+
+void latency_print(void) {
+    uart_puts("Resolution: ");
+    print_ns(clock_to_ns(1));
+    uart_puts("\n");
+
+    for (unsigned int src = 0; src < LAT_NR; src++) {
+        struct lat_hist sum = { 0 };
+
+        // Merge the per-hart histograms
+        for (unsigned int i = 0; i < MAX_HARTS; i++) {
+            struct lat_hist *h = &hists[i][src];
+            if (h->count == 0) continue;
+            if (sum.count == 0 || h->min < sum.min) sum.min = h->min;
+            if (h->max > sum.max) sum.max = h->max;
+            sum.count += h->count;
+            sum.sum += h->sum;
+            for (unsigned int b = 0; b < LAT_BUCKETS; b++)
+                sum.buckets[b] += h->buckets[b];
+        }
+
+        uart_puts(lat_names[src]);
+        uart_puts(": ");
+        if (sum.count == 0) {
+            uart_puts("no samples\n");
+            continue;
+        }
+        uart_putdec(sum.count);
+        uart_puts(" samples, min ");
+        print_ns(sum.min);
+        uart_puts(", avg ");
+        print_ns(sum.sum / sum.count);
+        uart_puts(", max ");
+        print_ns(sum.max);
+        uart_puts("\n");
+
+        for (unsigned int b = 0; b < LAT_BUCKETS; b++) {
+            if (!sum.buckets[b]) continue;
+            // The last bucket also holds everything beyond its range
+            if (b == LAT_BUCKETS - 1) {
+                uart_puts("  >= ");
+                print_ns(1UL << b);
+            } else {
+                uart_puts("  < ");
+                print_ns(2UL << b);
+            }
+            uart_puts("\t");
+            uart_putdec(sum.buckets[b]);
+            uart_puts("\n");
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "stdint.h"
+
+// Latency sources
+#define LAT_TIMER    0          // Programmed timer deadline -> timer trap entry
+#define LAT_IRQ      1          // Interrupt trap entry -> device handler entry
+#define LAT_SOFTIRQ  2          // softirq_raise -> bottom half starts running
+#define LAT_WAKEUP   3          // Wake-up event -> waiting code resumes
+#define LAT_NR       4
+
+#define LAT_BUCKETS  32         // Bucket i holds samples of [2^i, 2^(i+1)) ns
+
+// Record one sample, in clock ticks, on the calling hart
+void latency_record(unsigned int src, uint64_t ticks);
+
+// Record the time elapsed since a clock_now() timestamp
+void latency_since(unsigned int src, uint64_t stamp);
+
+void latency_print(void);
+void latency_reset(void);
+
+#endif
@@ -26,4 +26,21 @@ unsigned int strlen(const char *s) {
 // Minimal strcpy implementation
 void strcpy(char *dest, const char *src) {
     while ((*dest++ = *src++)) ; // Copy including '\0'
-}
\ No newline at end of file
+}
+
+// GCC may emit calls to these for struct copies and zeroing even in a
+// freestanding build. Keep it from turning the loops back into calls.
+#define NO_LOOP_CALLS __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+NO_LOOP_CALLS void *memset(void *dest, int c, unsigned long n) {
+    unsigned char *d = dest;
+    while (n--) *d++ = (unsigned char)c;
+    return dest;
+}
+
+NO_LOOP_CALLS void *memcpy(void *dest, const void *src, unsigned long n) {
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    while (n--) *d++ = *s++;
+    return dest;
+}
@@ -5,5 +5,7 @@ int strcmp(const char *a, const char *b);
 int strncmp(const char *a, const char *b, unsigned int n);
 unsigned int strlen(const char *s);
 void strcpy(char *dest, const char *src);
+void *memset(void *dest, int c, unsigned long n);
+void *memcpy(void *dest, const void *src, unsigned long n);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "stdint.h"
+#include "clock.h"
+#include "io.h"
+#include "libstr.h"
+#include "lock.h"
+
+//--------------------------------------------------
+//                 LOCK STATISTICS
+//--------------------------------------------------
+
+static struct lock_stats *stats_list;
+static spinlock_t stats_list_lock = SPINLOCK_INIT;
+
+void lock_stats_register(struct lock_stats *s) {
+    uint64_t flags = spin_lock_irqsave(&stats_list_lock);
+    s->next = stats_list;
+    stats_list = s;
+    spin_unlock_irqrestore(&stats_list_lock, flags);
+}
+
+// Racy against holders, which is fine for counters being zeroed
+void lock_stats_reset(void) {
+    for (struct lock_stats *s = stats_list; s; s = s->next) {
+        s->acquires = 0;
+        s->contended = 0;
+        s->wait_time = 0;
+        s->max_hold = 0;
+    }
+}
+
+void lock_stats_print(void) {
+    uart_puts("LOCK        ACQUIRES  CONTENDED  WAIT(us)  MAXHOLD(us)\n");
+    for (struct lock_stats *s = stats_list; s; s = s->next) {
+        if (!s->acquires) continue;
+        uart_puts(s->name);
+        for (unsigned int len = strlen(s->name); len < 12; len++) uart_putc(' ');
+        uart_putdec(s->acquires);
+        uart_puts("  ");
+        uart_putdec(s->contended);
+        uart_puts(" (");
+        uart_putdec(s->contended * 100 / s->acquires);
+        uart_puts("%)  ");
+        uart_putdec(clock_to_us(s->wait_time));
+        uart_puts("  ");
+        uart_putdec(clock_to_us(s->max_hold));
+        uart_puts("\n");
+    }
+}
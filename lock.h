@@ -0,0 +1,204 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+#include "spin.h"
+
+// Holders of any of these locks must not sleep, yield or be preempted:
+// use the _irqsave variants, or take them with interrupts already off.
+
+//--------------------------------------------------
+//                 LOCK STATISTICS
+//--------------------------------------------------
+// Optional: a lock whose stats pointer is set counts acquisitions,
+// contended acquisitions, time spent waiting and the longest hold. The
+// counters are only written while the lock is held. Registered stats
+// are listed by the lockstat command.
+
+struct lock_stats {
+    const char *name;
+    uint64_t acquires;
+    uint64_t contended;         // Acquisitions that had to wait
+    uint64_t wait_time;         // Clock ticks spent waiting, in total
+    uint64_t max_hold;          // Longest hold, clock ticks
+    uint64_t hold_start;
+    struct lock_stats *next;    // Registered list
+};
+
+#define LOCK_STATS_INIT(n) { (n), 0, 0, 0, 0, 0, NULL }
+
+void lock_stats_register(struct lock_stats *s);
+void lock_stats_print(void);
+void lock_stats_reset(void);
+
+// Called with the lock held; wait_start is 0 for an uncontended acquire
+static inline void lock_stat_acquired(struct lock_stats *s, uint64_t wait_start) {
+    uint64_t now = rdtime();
+    s->acquires++;
+    if (wait_start) {
+        s->contended++;
+        s->wait_time += now - wait_start;
+    }
+    s->hold_start = now;
+}
+
+static inline void lock_stat_release(struct lock_stats *s) {
+    uint64_t held = rdtime() - s->hold_start;
+    if (held > s->max_hold) s->max_hold = held;
+}
+
+//--------------------------------------------------
+//                   SPINLOCK
+//--------------------------------------------------
+// Test-and-test-and-set on amoswap: cheapest when uncontended, but
+// unfair and every release sets off a burst of swaps from the waiters.
+
+typedef struct {
+    volatile uint32_t locked;
+    struct lock_stats *stats;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0, NULL }
+#define SPINLOCK_INIT_STATS(s) { 0, (s) }
+
+static inline void spin_lock(spinlock_t *l) {
+    uint64_t wait_start = 0;
+    if (atomic_swap32(&l->locked, 1)) {
+        wait_start = rdtime();
+        do {
+            spin_wait32(&l->locked, 1);  // Spin on a plain load, not on the bus
+        } while (atomic_swap32(&l->locked, 1));
+    }
+    if (l->stats) lock_stat_acquired(l->stats, wait_start);
+}
+
+// Take the lock only if it is free; returns 1 if taken
+static inline int spin_trylock(spinlock_t *l) {
+    if (l->locked || atomic_swap32(&l->locked, 1)) return 0;
+    if (l->stats) lock_stat_acquired(l->stats, 0);
+    return 1;
+}
+
+static inline void spin_unlock(spinlock_t *l) {
+    if (l->stats) lock_stat_release(l->stats);
+    mb();                       // Critical section before the release
+    l->locked = 0;
+}
+
+// Disable interrupts, then lock; returns the previous interrupt state
+static inline uint64_t spin_lock_irqsave(spinlock_t *l) {
+    uint64_t s = intr_save();
+    spin_lock(l);
+    return s;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *l, uint64_t s) {
+    spin_unlock(l);
+    intr_restore(s);
+}
+
+//--------------------------------------------------
+//                  TICKET LOCK
+//--------------------------------------------------
+// FIFO fair: one amoadd to draw a ticket, then wait for owner to reach
+// it. Waiters still all spin on the same word.
+
+typedef struct {
+    volatile uint32_t next;     // Next ticket to hand out
+    volatile uint32_t owner;    // Ticket now holding the lock
+    struct lock_stats *stats;
+} ticket_lock_t;
+
+#define TICKET_LOCK_INIT { 0, 0, NULL }
+#define TICKET_LOCK_INIT_STATS(s) { 0, 0, (s) }
+
+static inline void ticket_lock(ticket_lock_t *l) {
+    uint32_t me = atomic_fetch_add32(&l->next, 1);
+    uint64_t wait_start = 0;
+    if (l->owner != me) {
+        wait_start = rdtime();
+        uint32_t owner;
+        while ((owner = l->owner) != me) spin_wait32(&l->owner, owner);
+    }
+    mb();                       // Acquire: nothing moves above the wait
+    if (l->stats) lock_stat_acquired(l->stats, wait_start);
+}
+
+static inline void ticket_unlock(ticket_lock_t *l) {
+    if (l->stats) lock_stat_release(l->stats);
+    mb();
+    l->owner = l->owner + 1;    // Only the holder writes owner
+}
+
+static inline uint64_t ticket_lock_irqsave(ticket_lock_t *l) {
+    uint64_t s = intr_save();
+    ticket_lock(l);
+    return s;
+}
+
+static inline void ticket_unlock_irqrestore(ticket_lock_t *l, uint64_t s) {
+    ticket_unlock(l);
+    intr_restore(s);
+}
+
+//--------------------------------------------------
+//                   MCS LOCK
+//--------------------------------------------------
+// Queue lock: each waiter spins on its own node (normally on its own
+// stack), and the holder hands over to its successor directly, so a
+// release touches one remote cache line however many harts wait.
+
+struct mcs_node {
+    struct mcs_node *volatile next;
+    volatile uint32_t locked;
+};
+
+typedef struct {
+    struct mcs_node *volatile tail;
+    struct lock_stats *stats;
+} mcs_lock_t;
+
+#define MCS_LOCK_INIT { NULL, NULL }
+#define MCS_LOCK_INIT_STATS(s) { NULL, (s) }
+
+static inline void mcs_lock(mcs_lock_t *l, struct mcs_node *n) {
+    n->next = NULL;
+    n->locked = 1;
+    struct mcs_node *prev =
+        (struct mcs_node *)atomic_swap64((volatile uint64_t *)&l->tail, (uint64_t)n);
+    uint64_t wait_start = 0;
+    if (prev) {
+        wait_start = rdtime();
+        prev->next = n;
+        spin_wait32(&n->locked, 1);
+        mb();
+    }
+    if (l->stats) lock_stat_acquired(l->stats, wait_start);
+}
+
+static inline void mcs_unlock(mcs_lock_t *l, struct mcs_node *n) {
+    if (l->stats) lock_stat_release(l->stats);
+    if (!n->next) {
+        // No known successor: try to mark the lock free
+        if (atomic_cmpxchg64((volatile uint64_t *)&l->tail, (uint64_t)n, 0) == (uint64_t)n)
+            return;
+        spin_wait64((volatile uint64_t *)&n->next, 0);  // A successor is linking itself in
+    }
+    mb();
+    n->next->locked = 0;
+}
+
+static inline uint64_t mcs_lock_irqsave(mcs_lock_t *l, struct mcs_node *n) {
+    uint64_t s = intr_save();
+    mcs_lock(l, n);
+    return s;
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t *l, struct mcs_node *n, uint64_t s) {
+    mcs_unlock(l, n);
+    intr_restore(s);
+}
+
+#endif
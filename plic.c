@@ -0,0 +1,94 @@
+#include "stdint.h"
+#include "plic.h"
+#include "cpu.h"
+
+//--------------------------------------------------
+//               PLIC REGISTER MAP
+//--------------------------------------------------
+// Each hart has an M-mode context (2*hart) and an S-mode context
+// (2*hart + 1); the kernel only ever programs the S-mode one.
+
+#define PLIC_PRIORITY(irq)    (PLIC_BASE + 4 * (irq))
+#define PLIC_ENABLE(ctx)      (PLIC_BASE + 0x2000 + 0x80 * (ctx))
+#define PLIC_THRESHOLD(ctx)   (PLIC_BASE + 0x200000 + 0x1000 * (ctx))
+#define PLIC_CLAIM(ctx)       (PLIC_THRESHOLD(ctx) + 4)
+
+static inline unsigned int plic_s_context(uint64_t hartid) {
+    return 2 * hartid + 1;
+}
+
+static inline volatile uint32_t *reg(uint64_t addr) {
+    return (volatile uint32_t *)addr;
+}
+
+//--------------------------------------------------
+//                 CONFIGURATION
+//--------------------------------------------------
+
+// Accept every priority above 0 on the calling hart's S-mode context
+void plic_init_hart(void) {
+    *reg(PLIC_THRESHOLD(plic_s_context(this_cpu()->hartid))) = 0;
+}
+
+void plic_set_priority(unsigned int irq, unsigned int prio) {
+    if (irq == 0 || irq >= PLIC_NR_IRQS) return;
+    *reg(PLIC_PRIORITY(irq)) = prio;
+}
+
+void plic_enable(unsigned int irq, uint64_t hartid) {
+    if (irq == 0 || irq >= PLIC_NR_IRQS) return;
+    volatile uint32_t *en = reg(PLIC_ENABLE(plic_s_context(hartid)) + 4 * (irq / 32));
+    *en |= 1U << (irq % 32);
+}
+
+void plic_disable(unsigned int irq, uint64_t hartid) {
+    if (irq == 0 || irq >= PLIC_NR_IRQS) return;
+    volatile uint32_t *en = reg(PLIC_ENABLE(plic_s_context(hartid)) + 4 * (irq / 32));
+    *en &= ~(1U << (irq % 32));
+}
+
+//--------------------------------------------------
+//               CLAIM / COMPLETE
+//--------------------------------------------------
+
+// Returns the highest-priority pending IRQ for this hart, 0 if none
+unsigned int plic_claim(void) {
+    return *reg(PLIC_CLAIM(plic_s_context(this_cpu()->hartid)));
+}
+
+void plic_complete(unsigned int irq) {
+    *reg(PLIC_CLAIM(plic_s_context(this_cpu()->hartid))) = irq;
+}
+
+//--------------------------------------------------
+//                  IRQ CHIP GLUE
+//--------------------------------------------------
+
+static void plic_setup(unsigned int irq) {
+    plic_set_priority(irq, 1);
+}
+
+// Each hart has its own S-mode context; a source is routed to a hart by
+// setting its enable bit there. With several harts enabled the PLIC
+// signals all of them and the first claim wins, the others read 0.
+static uint64_t plic_set_affinity(unsigned int irq, uint64_t old, uint64_t mask) {
+    // Enable the new harts first so the line is never routed nowhere
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if ((mask & (1UL << i)) && !(old & (1UL << i)))
+            plic_enable(irq, cpus[i].hartid);
+    }
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if ((old & (1UL << i)) && !(mask & (1UL << i)))
+            plic_disable(irq, cpus[i].hartid);
+    }
+    return mask;
+}
+
+const struct irq_chip plic_chip = {
+    .name = "PLIC",
+    .init_hart = plic_init_hart,
+    .setup = plic_setup,
+    .set_affinity = plic_set_affinity,
+    .claim = plic_claim,
+    .complete = plic_complete,
+};
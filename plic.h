@@ -0,0 +1,20 @@
+#ifndef PLIC_H
+#define PLIC_H
+
+#include "stdint.h"
+#include "irq.h"
+
+// QEMU virt PLIC
+#define PLIC_BASE      0x0c000000UL
+#define PLIC_NR_IRQS   96
+
+void plic_init_hart(void);
+void plic_set_priority(unsigned int irq, unsigned int prio);
+void plic_enable(unsigned int irq, uint64_t hartid);
+void plic_disable(unsigned int irq, uint64_t hartid);
+unsigned int plic_claim(void);
+void plic_complete(unsigned int irq);
+
+extern const struct irq_chip plic_chip;
+
+#endif
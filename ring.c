@@ -0,0 +1,221 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "io.h"
+#include "clock.h"
+#include "cpu.h"
+#include "spin.h"
+#include "thread.h"
+#include "ring.h"
+
+void spsc_init(struct spsc_ring *r, uint64_t *slots, uint32_t size) {
+    r->head = 0;
+    r->tail_cache = 0;
+    r->tail = 0;
+    r->head_cache = 0;
+    r->slots = slots;
+    r->mask = size - 1;
+}
+
+void mpsc_init(struct mpsc_queue *q, struct mpsc_slot *slots, uint64_t size) {
+    for (uint64_t i = 0; i < size; i++) slots[i].seq = i;
+    q->head = 0;
+    q->tail = 0;
+    q->slots = slots;
+    q->mask = size - 1;
+}
+
+//--------------------------------------------------
+//                  RINGBENCH
+//--------------------------------------------------
+// SPSC: online harts are paired up (1st->2nd, 3rd->4th, ...) and every
+// pair streams n messages at the same time. MPSC: every online hart but
+// the first sends n messages to a consumer on the first. Each side is a
+// thread pinned to its hart that spins while the ring is full or empty.
+// The consumer checks that every producer's messages arrive in order.
+
+#define RING_BENCH_SLOTS 256
+#define MAX_PAIRS (MAX_HARTS / 2)
+
+struct ring_side {
+    struct spsc_ring *ring;     // SPSC; NULL for the MPSC run
+    uint64_t n;                 // Messages per producer
+    unsigned int producers;     // MPSC consumer: how many to expect
+    uint64_t start;             // Producer: clock value of the first push
+    uint64_t end;               // Consumer: clock value of the last pop
+    uint64_t errors;            // Consumer: messages out of order
+};
+
+static struct spsc_ring bench_rings[MAX_PAIRS];
+static uint64_t bench_slots[MAX_PAIRS][RING_BENCH_SLOTS];
+static struct mpsc_queue bench_queue;
+static struct mpsc_slot bench_mpsc_slots[RING_BENCH_SLOTS];
+static struct ring_side bench_sides[MAX_HARTS];
+static volatile int bench_go;
+
+// MPSC messages carry the producer's hart in the top byte
+#define MSG_HART_SHIFT 56
+
+static int spsc_producer(void *arg) {
+    struct ring_side *s = arg;
+    while (!bench_go) cpu_relax();
+    s->start = clock_now();
+    for (uint64_t i = 0; i < s->n; i++)
+        while (!spsc_push(s->ring, i)) cpu_relax();
+    return 0;
+}
+
+static int spsc_consumer(void *arg) {
+    struct ring_side *s = arg;
+    uint64_t msg;
+    while (!bench_go) cpu_relax();
+    for (uint64_t i = 0; i < s->n; i++) {
+        while (!spsc_pop(s->ring, &msg)) cpu_relax();
+        if (msg != i) s->errors++;
+    }
+    s->end = clock_now();
+    return 0;
+}
+
+static int mpsc_producer(void *arg) {
+    struct ring_side *s = arg;
+    uint64_t tag = (uint64_t)(s - bench_sides) << MSG_HART_SHIFT;
+    while (!bench_go) cpu_relax();
+    s->start = clock_now();
+    for (uint64_t i = 0; i < s->n; i++)
+        while (!mpsc_push(&bench_queue, tag | i)) cpu_relax();
+    return 0;
+}
+
+static int mpsc_consumer(void *arg) {
+    struct ring_side *s = arg;
+    uint64_t next[MAX_HARTS] = { 0 };
+    uint64_t msg;
+    while (!bench_go) cpu_relax();
+    for (uint64_t i = 0; i < s->n * s->producers; i++) {
+        while (!mpsc_pop(&bench_queue, &msg)) cpu_relax();
+        unsigned int from = msg >> MSG_HART_SHIFT;
+        uint64_t seq = msg & ((1UL << MSG_HART_SHIFT) - 1);
+        if (from >= MAX_HARTS || seq != next[from]) s->errors++;
+        else next[from]++;
+    }
+    s->end = clock_now();
+    return 0;
+}
+
+static void print_rate(uint64_t elapsed, uint64_t msgs, uint64_t errors) {
+    uart_putdec(clock_to_us(elapsed));
+    uart_puts(" us, ");
+    uart_putdec(msgs ? clock_to_ns(elapsed) / msgs : 0);
+    uart_puts(" ns/msg, ");
+    uint64_t us = clock_to_us(elapsed);
+    uart_putdec(us ? msgs * 1000 / us : 0);
+    uart_puts(" msgs/ms");
+    if (errors) {
+        uart_puts(", ");
+        uart_putdec(errors);
+        uart_puts(" OUT OF ORDER");
+    }
+    uart_puts("\n");
+}
+
+// Start fns[i] on harts[i], then open the gate and wait for them all.
+// Returns -1 if a thread could not be created (the ones that were are
+// still joined).
+static int bench_run(const unsigned int *harts, thread_fn_t const *fns, int count) {
+    int tids[MAX_HARTS];
+    int ret = 0;
+    bench_go = 0;
+    for (int i = 0; i < count; i++) {
+        tids[i] = thread_create_on("ringbench", fns[i], &bench_sides[harts[i]], harts[i]);
+        if (tids[i] < 0) ret = -1;
+    }
+    // Without every producer, a consumer would wait forever: release
+    // them anyway with n = 0 left to do
+    if (ret) {
+        for (int i = 0; i < count; i++) bench_sides[harts[i]].n = 0;
+    }
+    mb();
+    bench_go = 1;
+    for (int i = 0; i < count; i++)
+        if (tids[i] >= 0) thread_join(tids[i], NULL);
+    return ret;
+}
+
+void ring_bench(uint64_t n) {
+    unsigned int online[MAX_HARTS];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < MAX_HARTS; i++)
+        if (cpus[i].online) online[count++] = i;
+    if (count < 2) {
+        uart_puts("ringbench: needs at least 2 harts\n");
+        return;
+    }
+
+    // SPSC, all pairs at once
+    unsigned int harts[MAX_HARTS];
+    thread_fn_t fns[MAX_HARTS];
+    unsigned int pairs = count / 2;
+    for (unsigned int p = 0; p < pairs; p++) {
+        unsigned int from = online[2 * p], to = online[2 * p + 1];
+        spsc_init(&bench_rings[p], bench_slots[p], RING_BENCH_SLOTS);
+        bench_sides[from] = (struct ring_side){ &bench_rings[p], n, 0, 0, 0, 0 };
+        bench_sides[to] = (struct ring_side){ &bench_rings[p], n, 0, 0, 0, 0 };
+        harts[2 * p] = from;
+        fns[2 * p] = spsc_producer;
+        harts[2 * p + 1] = to;
+        fns[2 * p + 1] = spsc_consumer;
+    }
+    if (bench_run(harts, fns, 2 * pairs) < 0) {
+        uart_puts("ringbench: no free thread slots\n");
+        return;
+    }
+
+    uart_puts("SPSC, ");
+    uart_putdec(RING_BENCH_SLOTS);
+    uart_puts(" slots, ");
+    uart_putdec(n);
+    uart_puts(" messages per pair:\n");
+    for (unsigned int p = 0; p < pairs; p++) {
+        struct ring_side *prod = &bench_sides[online[2 * p]];
+        struct ring_side *cons = &bench_sides[online[2 * p + 1]];
+        uart_puts("  hart ");
+        uart_putdec(cpus[online[2 * p]].hartid);
+        uart_puts(" -> ");
+        uart_putdec(cpus[online[2 * p + 1]].hartid);
+        uart_puts(": ");
+        print_rate(cons->end - prod->start, n, cons->errors);
+    }
+
+    // MPSC, every other hart into the first
+    mpsc_init(&bench_queue, bench_mpsc_slots, RING_BENCH_SLOTS);
+    for (unsigned int i = 0; i < count; i++) {
+        bench_sides[online[i]] = (struct ring_side){ NULL, n, count - 1, 0, 0, 0 };
+        harts[i] = online[(i + 1) % count];     // Consumer last
+        fns[i] = i == count - 1 ? mpsc_consumer : mpsc_producer;
+    }
+    if (bench_run(harts, fns, count) < 0) {
+        uart_puts("ringbench: no free thread slots\n");
+        return;
+    }
+
+    uint64_t start = ~0UL;
+    for (unsigned int i = 1; i < count; i++)
+        if (bench_sides[online[i]].start < start) start = bench_sides[online[i]].start;
+    struct ring_side *cons = &bench_sides[online[0]];
+
+    uart_puts("MPSC, ");
+    uart_putdec(RING_BENCH_SLOTS);
+    uart_puts(" slots, ");
+    uart_putdec(count - 1);
+    uart_puts(" producers x ");
+    uart_putdec(n);
+    uart_puts(" messages:\n  harts");
+    for (unsigned int i = 1; i < count; i++) {
+        uart_puts(i == 1 ? " " : ",");
+        uart_putdec(cpus[online[i]].hartid);
+    }
+    uart_puts(" -> ");
+    uart_putdec(cpus[online[0]].hartid);
+    uart_puts(": ");
+    print_rate(cons->end - start, n * (count - 1), cons->errors);
+}
@@ -0,0 +1,123 @@
+#ifndef RING_H
+#define RING_H
+
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+
+//--------------------------------------------------
+//              LOCK-FREE MESSAGE RINGS
+//--------------------------------------------------
+// Bounded queues of 64-bit messages (a value or a pointer) for handing
+// work between harts without a lock. The caller supplies the slot array;
+// its size must be a power of two.
+//
+//   - spsc_ring: one producer, one consumer. Each side only writes its
+//     own index and keeps a cached copy of the other, so the shared
+//     index lines move only when the cached view runs out.
+//   - mpsc_queue: any number of producers, one consumer. Producers claim
+//     a slot with a CAS on head; a per-slot sequence number says when
+//     the slot is free to fill and when its message is ready to read.
+//
+// The producer and consumer indices sit on separate cache lines, so the
+// two sides do not invalidate each other's line on every message.
+
+#define CACHELINE_SIZE 64
+
+struct spsc_ring {
+    // Producer's line
+    volatile uint32_t head __attribute__((aligned(CACHELINE_SIZE)));
+    uint32_t tail_cache;        // Last tail seen by the producer
+
+    // Consumer's line
+    volatile uint32_t tail __attribute__((aligned(CACHELINE_SIZE)));
+    uint32_t head_cache;        // Last head seen by the consumer
+
+    // Read-only after init
+    uint64_t *slots __attribute__((aligned(CACHELINE_SIZE)));
+    uint32_t mask;
+};
+
+struct mpsc_slot {
+    volatile uint64_t seq;      // pos: free for message pos; pos + 1: filled
+    uint64_t msg;
+};
+
+struct mpsc_queue {
+    volatile uint64_t head __attribute__((aligned(CACHELINE_SIZE)));   // Producers
+    uint64_t tail __attribute__((aligned(CACHELINE_SIZE)));            // Consumer
+    struct mpsc_slot *slots __attribute__((aligned(CACHELINE_SIZE)));
+    uint64_t mask;
+};
+
+void spsc_init(struct spsc_ring *r, uint64_t *slots, uint32_t size);
+void mpsc_init(struct mpsc_queue *q, struct mpsc_slot *slots, uint64_t size);
+
+// Returns 0 if the ring is full
+static inline int spsc_push(struct spsc_ring *r, uint64_t msg) {
+    uint32_t head = r->head;
+    if (head - r->tail_cache > r->mask) {
+        r->tail_cache = r->tail;
+        if (head - r->tail_cache > r->mask) return 0;
+    }
+    r->slots[head & r->mask] = msg;
+    wmb();                      // Message before the index that publishes it
+    r->head = head + 1;
+    return 1;
+}
+
+// Returns 0 if the ring is empty
+static inline int spsc_pop(struct spsc_ring *r, uint64_t *msg) {
+    uint32_t tail = r->tail;
+    if (tail == r->head_cache) {
+        r->head_cache = r->head;
+        if (tail == r->head_cache) return 0;
+        rmb();                  // Index before the message
+    }
+    *msg = r->slots[tail & r->mask];
+    mb();                       // Finish the read before freeing the slot
+    r->tail = tail + 1;
+    return 1;
+}
+
+// Returns 0 if the queue is full
+static inline int mpsc_push(struct mpsc_queue *q, uint64_t msg) {
+    uint64_t pos = q->head;
+    struct mpsc_slot *s;
+    for (;;) {
+        s = &q->slots[pos & q->mask];
+        int64_t diff = (int64_t)(s->seq - pos);
+        if (diff == 0) {
+            uint64_t old = atomic_cmpxchg64(&q->head, pos, pos + 1);
+            if (old == pos) break;
+            pos = old;          // Another producer took it
+        } else if (diff < 0) {
+            return 0;           // Not yet consumed: full
+        } else {
+            pos = q->head;      // Slot already reused: head moved on
+        }
+    }
+    s->msg = msg;
+    wmb();
+    s->seq = pos + 1;
+    return 1;
+}
+
+// Single consumer only. Returns 0 if the next message is not ready,
+// even if later ones are
+static inline int mpsc_pop(struct mpsc_queue *q, uint64_t *msg) {
+    uint64_t pos = q->tail;
+    struct mpsc_slot *s = &q->slots[pos & q->mask];
+    if (s->seq != pos + 1) return 0;
+    rmb();
+    *msg = s->msg;
+    mb();
+    s->seq = pos + q->mask + 1;  // Free for the message one lap later
+    q->tail = pos + 1;
+    return 1;
+}
+
+// Throughput between hart pairs (ringbench command)
+void ring_bench(uint64_t n);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef RISCV_H
+#define RISCV_H
+
+//--------------------------------------------------
+//        SUPERVISOR CSR BITS AND CAUSE CODES
+//--------------------------------------------------
+
+// sstatus bits
+#define SSTATUS_SIE   (1UL << 1)     // Supervisor interrupt enable
+#define SSTATUS_SPIE  (1UL << 5)     // Interrupt enable before trap
+#define SSTATUS_SPP   (1UL << 8)     // Previous privilege (1 = S-mode)
+#define SSTATUS_VS    (3UL << 9)     // Vector state: off/initial/clean/dirty
+#define SSTATUS_FS    (3UL << 13)    // FP state: off/initial/clean/dirty
+
+// Values of the FS and VS fields, shifted into place with these
+#define SSTATUS_FS_SHIFT  13
+#define SSTATUS_VS_SHIFT  9
+#define XS_OFF        0UL
+#define XS_INITIAL    1UL
+#define XS_CLEAN      2UL
+#define XS_DIRTY      3UL
+
+// sie / sip bits
+#define SIE_SSIE      (1UL << 1)     // Software interrupt (IPIs)
+#define SIE_STIE      (1UL << 5)     // Timer interrupt
+#define SIE_SEIE      (1UL << 9)     // External interrupt (PLIC)
+
+// scause: top bit set means the trap was an interrupt
+#define SCAUSE_INTERRUPT (1UL << 63)
+
+// Interrupt cause codes
+#define IRQ_S_SOFT    1
+#define IRQ_S_TIMER   5
+#define IRQ_S_EXT     9
+
+// Exception cause codes
+#define EXC_INST_MISALIGNED   0
+#define EXC_INST_ACCESS       1
+#define EXC_ILLEGAL_INST      2
+#define EXC_BREAKPOINT        3
+#define EXC_LOAD_MISALIGNED   4
+#define EXC_LOAD_ACCESS       5
+#define EXC_STORE_MISALIGNED  6
+#define EXC_STORE_ACCESS      7
+#define EXC_ECALL_U           8
+#define EXC_ECALL_S           9
+#define EXC_INST_PAGE_FAULT   12
+#define EXC_LOAD_PAGE_FAULT   13
+#define EXC_STORE_PAGE_FAULT  15
+
+// stvec mode field
+#define STVEC_MODE_DIRECT   0
+#define STVEC_MODE_VECTORED 1
+
+#ifndef __ASSEMBLER__
+
+#include "stdint.h"
+
+//--------------------------------------------------
+//               CSR ACCESS HELPERS
+//--------------------------------------------------
+
+#define csr_read(csr) ({                                   \
+    uint64_t __v;                                          \
+    asm volatile("csrr %0, " #csr : "=r"(__v) :: "memory"); \
+    __v; })
+
+#define csr_write(csr, val) ({                             \
+    uint64_t __v = (uint64_t)(val);                        \
+    asm volatile("csrw " #csr ", %0" :: "r"(__v) : "memory"); })
+
+#define csr_set(csr, bits) ({                              \
+    uint64_t __v = (uint64_t)(bits);                       \
+    asm volatile("csrs " #csr ", %0" :: "r"(__v) : "memory"); })
+
+#define csr_clear(csr, bits) ({                            \
+    uint64_t __v = (uint64_t)(bits);                       \
+    asm volatile("csrc " #csr ", %0" :: "r"(__v) : "memory"); })
+
+//--------------------------------------------------
+//            INTERRUPT ENABLE HELPERS
+//--------------------------------------------------
+
+static inline void intr_on(void)  { csr_set(sstatus, SSTATUS_SIE); }
+static inline void intr_off(void) { csr_clear(sstatus, SSTATUS_SIE); }
+
+// Disable interrupts, returning the previous SIE state for intr_restore
+static inline uint64_t intr_save(void) {
+    uint64_t prev;
+    asm volatile("csrrci %0, sstatus, 2" : "=r"(prev) :: "memory");
+    return prev & SSTATUS_SIE;
+}
+
+static inline void intr_restore(uint64_t prev) {
+    if (prev) intr_on();
+}
+
+static inline void wfi(void) {
+    asm volatile("wfi" ::: "memory");
+}
+
+// Read the platform timer (ticks at the timebase frequency)
+static inline uint64_t rdtime(void) {
+    uint64_t t;
+    asm volatile("rdtime %0" : "=r"(t));
+    return t;
+}
+
+// Hart cycle and retired-instruction counters (S-mode access is
+// granted by firmware through mcounteren)
+static inline uint64_t rdcycle(void) {
+    uint64_t c;
+    asm volatile("rdcycle %0" : "=r"(c));
+    return c;
+}
+
+static inline uint64_t rdinstret(void) {
+    uint64_t i;
+    asm volatile("rdinstret %0" : "=r"(i));
+    return i;
+}
+
+//--------------------------------------------------
+//                MEMORY BARRIERS
+//--------------------------------------------------
+
+#define mb()   asm volatile("fence rw, rw" ::: "memory")
+#define rmb()  asm volatile("fence r, r" ::: "memory")
+#define wmb()  asm volatile("fence w, w" ::: "memory")
+
+#endif // __ASSEMBLER__
+
+#endif
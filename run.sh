@@ -1,6 +1,7 @@
 qemu-system-riscv64 \
-    -machine virt \
+    -machine virt${AIA:+,aia=aplic-imsic} \
     -m 128M \
+    -smp 4 \
     -bios /usr/share/qemu/opensbi-riscv64-generic-fw_dynamic.bin \
     -kernel kernel.elf \
     -serial mon:stdio 
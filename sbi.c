@@ -0,0 +1,94 @@
+#include "stdint.h"
+#include "sbi.h"
+
+//--------------------------------------------------
+//               GENERIC SBI ECALL
+//--------------------------------------------------
+
+// a7 = extension, a6 = function, a0..a3 = arguments; a0/a1 hold the result
+struct sbiret sbi_call(unsigned long ext, unsigned long fid,
+                       unsigned long arg0, unsigned long arg1,
+                       unsigned long arg2, unsigned long arg3) {
+    register unsigned long a0 asm("a0") = arg0;
+    register unsigned long a1 asm("a1") = arg1;
+    register unsigned long a2 asm("a2") = arg2;
+    register unsigned long a3 asm("a3") = arg3;
+    register unsigned long a6 asm("a6") = fid;
+    register unsigned long a7 asm("a7") = ext;
+    asm volatile("ecall"
+                 : "+r"(a0), "+r"(a1)
+                 : "r"(a2), "r"(a3), "r"(a6), "r"(a7)
+                 : "memory");
+
+    struct sbiret ret = { (long)a0, (long)a1 };
+    return ret;
+}
+
+//--------------------------------------------------
+//              EXTENSION DISCOVERY
+//--------------------------------------------------
+
+static int has_time_ext = 0;
+
+// Base extension, function 3: probe_extension (non-zero value = present)
+int sbi_probe_extension(unsigned long ext) {
+    struct sbiret r = sbi_call(SBI_EXT_BASE, 3, ext, 0, 0, 0);
+    return r.error == 0 && r.value != 0;
+}
+
+void sbi_init(void) {
+    has_time_ext = sbi_probe_extension(SBI_EXT_TIME);
+}
+
+//--------------------------------------------------
+//                     TIMER
+//--------------------------------------------------
+
+// Program the next S-mode timer interrupt. Writing a value in the future
+// also clears a pending STIP; all-ones effectively disarms the timer.
+void sbi_set_timer(uint64_t stime_value) {
+    if (has_time_ext)
+        sbi_call(SBI_EXT_TIME, 0, stime_value, 0, 0, 0);
+    else
+        sbi_call(SBI_EXT_LEGACY_SET_TIMER, 0, stime_value, 0, 0, 0);
+}
+
+//--------------------------------------------------
+//               IPI / REMOTE FENCE
+//--------------------------------------------------
+
+void sbi_send_ipi(uint64_t hart_mask, uint64_t hart_mask_base) {
+    sbi_call(SBI_EXT_IPI, 0, hart_mask, hart_mask_base, 0, 0);
+}
+
+// RFENCE function 2: remote sfence.vma limited to one ASID.
+// start = 0, size = -1 flushes the whole address space.
+void sbi_remote_sfence_vma_asid(uint64_t hart_mask, uint64_t hart_mask_base,
+                                uint64_t start, uint64_t size, uint64_t asid) {
+    register unsigned long a0 asm("a0") = hart_mask;
+    register unsigned long a1 asm("a1") = hart_mask_base;
+    register unsigned long a2 asm("a2") = start;
+    register unsigned long a3 asm("a3") = size;
+    register unsigned long a4 asm("a4") = asid;
+    register unsigned long a6 asm("a6") = 2;
+    register unsigned long a7 asm("a7") = SBI_EXT_RFENCE;
+    asm volatile("ecall"
+                 : "+r"(a0), "+r"(a1)
+                 : "r"(a2), "r"(a3), "r"(a4), "r"(a6), "r"(a7)
+                 : "memory");
+}
+
+//--------------------------------------------------
+//              HART STATE MANAGEMENT
+//--------------------------------------------------
+
+// Start a stopped hart at start_addr in S-mode with a0 = hartid, a1 = opaque
+long sbi_hart_start(uint64_t hartid, uint64_t start_addr, uint64_t opaque) {
+    return sbi_call(SBI_EXT_HSM, 0, hartid, start_addr, opaque, 0).error;
+}
+
+// Returns an SBI_HSM_* state, or a negative error for a nonexistent hart
+long sbi_hart_get_status(uint64_t hartid) {
+    struct sbiret r = sbi_call(SBI_EXT_HSM, 2, hartid, 0, 0, 0);
+    return r.error ? r.error : r.value;
+}
@@ -0,0 +1,44 @@
+#ifndef SBI_H
+#define SBI_H
+
+#include "stdint.h"
+
+// SBI extension IDs
+#define SBI_EXT_LEGACY_SET_TIMER 0x00
+#define SBI_EXT_BASE    0x10
+#define SBI_EXT_TIME    0x54494D45      // "TIME"
+#define SBI_EXT_IPI     0x735049        // "sPI"
+#define SBI_EXT_RFENCE  0x52464E43      // "RFNC"
+#define SBI_EXT_HSM     0x48534D        // "HSM"
+
+// HSM hart states
+#define SBI_HSM_STARTED 0
+#define SBI_HSM_STOPPED 1
+
+// Return pair from every SBI v0.2+ call
+struct sbiret {
+    long error;                 // 0 on success, negative SBI error code
+    long value;
+};
+
+struct sbiret sbi_call(unsigned long ext, unsigned long fid,
+                       unsigned long arg0, unsigned long arg1,
+                       unsigned long arg2, unsigned long arg3);
+
+// Probe available extensions (call once at boot)
+void sbi_init(void);
+int sbi_probe_extension(unsigned long ext);
+
+// Program the next timer interrupt (absolute `time` value)
+void sbi_set_timer(uint64_t stime_value);
+
+// Inter-processor: hart_mask bit n = hart (hart_mask_base + n)
+void sbi_send_ipi(uint64_t hart_mask, uint64_t hart_mask_base);
+void sbi_remote_sfence_vma_asid(uint64_t hart_mask, uint64_t hart_mask_base,
+                                uint64_t start, uint64_t size, uint64_t asid);
+
+// Hart state management
+long sbi_hart_start(uint64_t hartid, uint64_t start_addr, uint64_t opaque);
+long sbi_hart_get_status(uint64_t hartid);
+
+#endif
@@ -0,0 +1,58 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "sbi.h"
+#include "cpu.h"
+#include "trap.h"
+#include "irq.h"
+#include "ipi.h"
+#include "timer.h"
+#include "clock.h"
+#include "spin.h"
+#include "io.h"
+#include "thread.h"
+#include "fpu.h"
+#include "smp.h"
+
+//--------------------------------------------------
+//              SECONDARY HART BRING-UP
+//--------------------------------------------------
+
+// boot.S: sets up the per-hart stack and calls smp_secondary_main
+extern void _secondary_start(void);
+
+// How long to wait for a started hart to check in
+#define SMP_BOOT_TIMEOUT_MS 100
+
+void smp_secondary_main(uint64_t hartid, uint64_t id) {
+    cpu_init(id, hartid);
+    trap_init_hart();
+    fpu_init_hart();
+    irq_init_hart();
+    ipi_init_hart();
+    timer_init_hart();
+    cpu_set_online();
+
+    // Become this hart's idle thread: steal work or sleep in wfi
+    thread_idle_hart();
+}
+
+void smp_init(void) {
+    uint64_t self = this_cpu()->hartid;
+    unsigned int next_id = 1;
+
+    // Hart ids on QEMU virt are dense, so probing 0..MAX_HARTS-1 finds them all
+    for (uint64_t hartid = 0; hartid < MAX_HARTS && next_id < MAX_HARTS; hartid++) {
+        if (hartid == self) continue;
+        if (sbi_hart_get_status(hartid) != SBI_HSM_STOPPED) continue;
+        if (sbi_hart_start(hartid, (uint64_t)_secondary_start, next_id) == 0)
+            next_id++;
+    }
+
+    // Wait (bounded) for the started harts to come online
+    uint64_t deadline = clock_now() + clock_hz() / 1000 * SMP_BOOT_TIMEOUT_MS;
+    while (cpu_count() < next_id && clock_now() < deadline) cpu_relax();
+
+    uart_puts("SMP: ");
+    uart_putdec(cpu_count());
+    uart_puts(" hart(s) online\n");
+}
@@ -0,0 +1,12 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "stdint.h"
+
+// Start every other hart SBI reports as stopped (boot hart only)
+void smp_init(void);
+
+// C entry for secondary harts (from boot.S)
+void smp_secondary_main(uint64_t hartid, uint64_t id);
+
+#endif
@@ -0,0 +1,55 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "cpu.h"
+#include "latency.h"
+#include "softirq.h"
+
+//--------------------------------------------------
+//               SOFTIRQ BOTTOM HALVES
+//--------------------------------------------------
+// Hard interrupt handlers do the minimum (acknowledge the device, grab
+// its data) and raise a softirq. Pending vectors run on the way out of
+// the interrupt with interrupts re-enabled, so a burst of events is
+// processed in one pass while new interrupts can still be taken.
+
+// Passes over newly raised vectors before leaving the rest to idle time
+#define SOFTIRQ_MAX_ROUNDS 4
+
+static softirq_fn_t softirq_vec[NR_SOFTIRQS];
+
+void softirq_register(unsigned int nr, softirq_fn_t fn) {
+    if (nr < NR_SOFTIRQS) softirq_vec[nr] = fn;
+}
+
+void softirq_raise(unsigned int nr) {
+    struct cpu *c = this_cpu();
+    if (!c->softirq_pending) c->softirq_raised = rdtime();
+    c->softirq_pending |= 1U << nr;
+}
+
+int softirq_pending(void) {
+    return this_cpu()->softirq_pending != 0;
+}
+
+void softirq_run(void) {
+    struct cpu *c = this_cpu();
+
+    // A nested interrupt during a softirq leaves its work to this loop
+    if (c->in_softirq) return;
+    c->in_softirq = 1;
+
+    for (int round = 0; round < SOFTIRQ_MAX_ROUNDS && c->softirq_pending; round++) {
+        uint32_t pending = c->softirq_pending;
+        c->softirq_pending = 0;
+        latency_since(LAT_SOFTIRQ, c->softirq_raised);
+
+        intr_on();
+        for (unsigned int nr = 0; nr < NR_SOFTIRQS; nr++) {
+            if ((pending & (1U << nr)) && softirq_vec[nr])
+                softirq_vec[nr]();
+        }
+        intr_off();
+    }
+
+    c->in_softirq = 0;
+}
@@ -0,0 +1,21 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+// Bottom-half vectors, run in this order
+#define SOFTIRQ_TIMER    0      // Expire timer wheel buckets
+#define SOFTIRQ_UART_TX  1      // Refill the UART transmit FIFO
+#define NR_SOFTIRQS      8
+
+typedef void (*softirq_fn_t)(void);
+
+void softirq_register(unsigned int nr, softirq_fn_t fn);
+
+// Mark a vector pending on the calling hart (interrupts must be off)
+void softirq_raise(unsigned int nr);
+
+// Run pending vectors with interrupts enabled. Called on interrupt exit
+// and from the idle loop; call with interrupts disabled.
+void softirq_run(void);
+int softirq_pending(void);
+
+#endif
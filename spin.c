@@ -0,0 +1,23 @@
+#include "stdint.h"
+#include "io.h"
+#include "trap.h"
+#include "spin.h"
+
+//--------------------------------------------------
+//                 ZAWRS DETECTION
+//--------------------------------------------------
+// Harts without Zawrs raise an illegal instruction on wrs.*. The probe
+// uses wrs.sto, which is bounded even if a reservation happens to be
+// held. Until spin_init runs every wait falls back to pause, which is
+// safe on any hart.
+
+int spin_has_zawrs = 0;
+
+void spin_init(void) {
+    trap_probe_begin();
+    wrs_sto();
+    spin_has_zawrs = !trap_probe_end();
+
+    uart_puts(spin_has_zawrs ? "Spin-wait: wrs.nto (Zawrs)\n"
+                             : "Spin-wait: pause\n");
+}
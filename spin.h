@@ -0,0 +1,71 @@
+#ifndef SPIN_H
+#define SPIN_H
+
+#include "stdint.h"
+
+//--------------------------------------------------
+//                  SPIN-WAITING
+//--------------------------------------------------
+// Busy-wait loops back off with one of two hints, so a spinning hart
+// leaves the interconnect (and, under QEMU, the host CPU) to others:
+//   - Zawrs: LR the watched word, then wrs.nto stalls until another hart
+//     stores to it or an interrupt is pending (even with SIE clear)
+//   - Zihintpause: pause, a short delay; it encodes as a fence that
+//     older harts execute as a no-op
+// Loops on MMIO registers or on several words use cpu_relax; loops on
+// one word of memory use spin_wait32/64.
+
+extern int spin_has_zawrs;
+
+// Probe for Zawrs; call once the trap handler is installed
+void spin_init(void);
+
+static inline void cpu_relax(void) {
+    asm volatile(".insn i 0x0f, 0, x0, x0, 0x010" ::: "memory");   // pause
+}
+
+static inline void wrs_nto(void) {
+    asm volatile(".insn i 0x73, 0, x0, x0, 0x00d" ::: "memory");   // wrs.nto
+}
+
+static inline void wrs_sto(void) {
+    asm volatile(".insn i 0x73, 0, x0, x0, 0x01d" ::: "memory");   // wrs.sto
+}
+
+// One back-off step while *p == old. Returns early on a store to *p or
+// a pending interrupt, so callers that must keep servicing IPIs can
+// interleave ipi_poll
+static inline void spin_pause32(volatile uint32_t *p, uint32_t old) {
+    if (spin_has_zawrs) {
+        uint32_t v;
+        asm volatile("lr.w %0, (%1)" : "=r"(v) : "r"(p) : "memory");
+        if (v == old) wrs_nto();
+    } else {
+        cpu_relax();
+    }
+}
+
+static inline void spin_pause64(volatile uint64_t *p, uint64_t old) {
+    if (spin_has_zawrs) {
+        uint64_t v;
+        asm volatile("lr.d %0, (%1)" : "=r"(v) : "r"(p) : "memory");
+        if (v == old) wrs_nto();
+    } else {
+        cpu_relax();
+    }
+}
+
+// Spin until *p != old; returns the new value
+static inline uint32_t spin_wait32(volatile uint32_t *p, uint32_t old) {
+    uint32_t v;
+    while ((v = *p) == old) spin_pause32(p, old);
+    return v;
+}
+
+static inline uint64_t spin_wait64(volatile uint64_t *p, uint64_t old) {
+    uint64_t v;
+    while ((v = *p) == old) spin_pause64(p, old);
+    return v;
+}
+
+#endif
@@ -0,0 +1,950 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+#include "lock.h"
+#include "trap.h"
+#include "clock.h"
+#include "timer.h"
+#include "ipi.h"
+#include "cpu.h"
+#include "io.h"
+#include "wait.h"
+#include "fpu.h"
+#include "thread.h"
+
+//--------------------------------------------------
+//                 KERNEL THREADS
+//--------------------------------------------------
+// Threads come from a static pool, each with its own stack slot. Every
+// hart has its own run queue and an idle thread that runs when the
+// queue is empty. A thread runs until it yields, sleeps on a wait queue
+// (leaving the run queue until woken), exits, or is preempted at
+// interrupt exit when its timeslice expires or a better thread wakes.
+// The slice timer is only armed while another thread is waiting on the
+// same hart. Which ready thread goes next depends on the scheduling
+// classes below.
+//
+// A hart going idle steals the oldest ready thread from the busiest
+// queue, and queueing work behind a running thread kicks an idle hart.
+// Each run queue has its own lock, taken with interrupts off. No path
+// holds two run queue locks; a wake takes one inside a wait queue lock.
+
+void switch_context(struct context *old, struct context *new);
+
+struct runqueue {
+    spinlock_t lock;
+    struct thread *head;
+    struct thread *tail;
+    volatile unsigned int nr;   // Ready threads, not counting the running one
+};
+
+static struct thread threads[MAX_THREADS];
+static uint8_t thread_stacks[MAX_THREADS][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+static struct runqueue runqs[MAX_HARTS];
+static struct thread idle_threads[MAX_HARTS];
+static struct timer slice_timers[MAX_HARTS];
+static volatile uint64_t idle_mask;     // Harts sleeping in their idle thread
+static uint64_t timeslice_ms = TIMESLICE_MS;
+
+// The boot hart's idle thread is created, not adopted: it needs a stack
+static uint8_t idle_stack0[THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+static struct lock_stats pool_lock_stats = LOCK_STATS_INIT("threads");
+// Every hart takes it to create, exit, join and detach threads (parallel
+// and ringbench do so all at once): a ticket lock serves them in order
+static ticket_lock_t pool_lock = TICKET_LOCK_INIT_STATS(&pool_lock_stats);
+
+static struct lock_stats runq_stats[MAX_HARTS];
+static const char *runq_names[MAX_HARTS] = {
+    "runq0", "runq1", "runq2", "runq3", "runq4", "runq5", "runq6", "runq7",
+};
+static int next_tid = 1;
+
+// Joiners sleep here; every exit wakes them all to re-check
+static struct waitqueue exit_wait = WAITQUEUE_INIT;
+
+static const char *state_names[] = {
+    "unused", "ready", "running", "blocked", "zombie", "throttled",
+};
+
+static void set_name(struct thread *t, const char *name) {
+    int i = 0;
+    for (; name[i] && i < THREAD_NAME_LEN - 1; i++) t->name[i] = name[i];
+    t->name[i] = '\0';
+}
+
+static struct thread *thread_find(int tid) {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if (threads[i].state != THREAD_UNUSED && threads[i].tid == tid)
+            return &threads[i];
+    }
+    return NULL;
+}
+
+//--------------------------------------------------
+//               SCHEDULING CLASSES
+//--------------------------------------------------
+// Run queues hold threads of every class and picking one scans the
+// queue (it is short): the earliest absolute deadline among deadline
+// threads, else the highest-priority FIFO thread, else the fair thread
+// queued first. Equal threads go in queue order, which makes both FIFO
+// (within a priority) and fair round-robin.
+//
+// Fair threads get a timeslice weighted by nice. FIFO threads have none
+// and run until they block or a better thread wakes. A deadline thread
+// gets dl_runtime of CPU per dl_period; once it has used that budget it
+// is throttled off the queue until the period ends, so an overrunning
+// one cannot starve the classes below (constant bandwidth server).
+// Admission keeps reservations under DL_BW_MAX_PCT of the online harts.
+
+// Slice weight per nice level (-20..19): 1024 at 0, ~1.25x per step
+static const uint32_t nice_weight[NICE_MAX - NICE_MIN + 1] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,  3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,   335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,    36,    29,    23,    18,    15,
+};
+
+// Reserved deadline bandwidth, in 1/1024 of a hart (under pool_lock)
+static uint64_t dl_bw_total;
+
+static uint64_t dl_bw(const struct thread *t) {
+    return t->dl_runtime * 1024 / t->dl_period;
+}
+
+static uint64_t ms_to_ticks(uint64_t ms) {
+    return ms * clock_hz() / 1000;
+}
+
+// 1 if a should run before b
+static int sched_before(const struct thread *a, const struct thread *b) {
+    if (a->policy != b->policy) return a->policy > b->policy;
+    if (a->policy == SCHED_DEADLINE) return a->dl_abs_deadline < b->dl_abs_deadline;
+    if (a->policy == SCHED_FIFO) return a->prio > b->prio;
+    return 0;
+}
+
+// A new activation once the last period is over: fresh budget and deadline
+static void dl_replenish(struct thread *t, uint64_t now) {
+    if (now < t->dl_period_end) return;
+    t->dl_left = t->dl_runtime;
+    t->dl_abs_deadline = now + t->dl_deadline;
+    t->dl_period_end = now + t->dl_period;
+}
+
+// Charge the running thread for its time since exec_start
+static void account(struct thread *t, uint64_t now) {
+    uint64_t delta = now - t->exec_start;
+    t->runtime += delta;
+    t->exec_start = now;
+    if (t->policy == SCHED_DEADLINE) t->dl_left -= delta;
+}
+
+//--------------------------------------------------
+//                   RUN QUEUES
+//--------------------------------------------------
+
+// Caller holds rq->lock
+static void rq_push(struct runqueue *rq, struct thread *t) {
+    if (t->policy == SCHED_DEADLINE) dl_replenish(t, clock_now());
+    t->state = THREAD_RUNNABLE;
+    t->next = NULL;
+    if (rq->tail) rq->tail->next = t;
+    else rq->head = t;
+    rq->tail = t;
+    rq->nr++;
+}
+
+// Best thread whose context is not live on some hart (and, when
+// stealing, that is not pinned). Caller holds rq->lock.
+static struct thread *rq_best(struct runqueue *rq, int stealing) {
+    struct thread *best = NULL;
+    for (struct thread *t = rq->head; t; t = t->next) {
+        if (t->on_cpu || (stealing && t->pinned)) continue;
+        if (!best || sched_before(t, best)) best = t;
+    }
+    return best;
+}
+
+static struct thread *rq_pop(struct runqueue *rq, int stealing) {
+    struct thread *t = rq_best(rq, stealing);
+    if (!t) return NULL;
+
+    struct thread *prev = NULL;
+    for (struct thread *p = rq->head; p != t; p = p->next) prev = p;
+    if (prev) prev->next = t->next;
+    else rq->head = t->next;
+    if (rq->tail == t) rq->tail = prev;
+    t->next = NULL;
+    rq->nr--;
+    return t;
+}
+
+// Wake an idle hart so it can steal the thread just queued here
+static void kick_idle(unsigned int self) {
+    mb();                       // Queue update before reading idle_mask
+    uint64_t idle = idle_mask & ~(1UL << self);
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (idle & (1UL << i)) {
+            ipi_send(i, IPI_WAKEUP);
+            return;
+        }
+    }
+}
+
+// Move the oldest stealable thread of the busiest other hart to our
+// queue. Returns 1 if one was taken.
+static int steal(unsigned int self) {
+    unsigned int victim = self;
+    unsigned int most = 0;
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (i != self && runqs[i].nr > most) {
+            most = runqs[i].nr;
+            victim = i;
+        }
+    }
+    if (victim == self) return 0;
+
+    spin_lock(&runqs[victim].lock);
+    struct thread *t = rq_pop(&runqs[victim], 1);
+    spin_unlock(&runqs[victim].lock);
+    if (!t) return 0;
+
+    spin_lock(&runqs[self].lock);
+    rq_push(&runqs[self], t);
+    spin_unlock(&runqs[self].lock);
+    return 1;
+}
+
+//--------------------------------------------------
+//                   SCHEDULING
+//--------------------------------------------------
+
+static void slice_expired(struct timer *t, void *arg) {
+    (void)t; (void)arg;
+    this_cpu()->need_resched = 1;
+}
+
+static uint64_t slice_ms(struct thread *t) {
+    uint64_t ms = timeslice_ms * nice_weight[t->nice - NICE_MIN] / 1024;
+    return ms ? ms : 1;
+}
+
+// Round-robin only matters while someone is waiting for this hart; a
+// deadline thread is stopped when its budget runs out, waiting or not
+static void slice_update(struct cpu *c) {
+    struct timer *t = &slice_timers[c->id];
+    struct thread *cur = c->current;
+    if (cur == c->idle || cur->policy == SCHED_FIFO) {
+        timer_cancel(t);
+    } else if (cur->policy == SCHED_DEADLINE) {
+        if (!timer_pending(t)) {
+            uint64_t left = cur->dl_left > 0 ? (uint64_t)cur->dl_left : 0;
+            timer_start(t, clock_to_ms(left + clock_hz() / 1000 - 1));
+        }
+    } else if (runqs[c->id].nr) {
+        if (!timer_pending(t)) timer_start(t, slice_ms(cur));
+    } else {
+        timer_cancel(t);
+    }
+}
+
+// Period over: back on the queue of the hart that throttled it (the
+// timer fires there)
+static void dl_unthrottle(struct timer *timer, void *arg) {
+    (void)timer;
+    struct thread *t = arg;
+    if (atomic_cmpxchg32((volatile uint32_t *)&t->state, THREAD_THROTTLED,
+                         THREAD_RUNNABLE) != THREAD_THROTTLED)
+        return;
+
+    // Timer callbacks run with interrupts off, as run queue locks need
+    struct cpu *c = this_cpu();
+    spin_lock(&runqs[c->id].lock);
+    rq_push(&runqs[c->id], t);
+    spin_unlock(&runqs[c->id].lock);
+    if (c->current == c->idle || sched_before(t, c->current)) c->need_resched = 1;
+    else slice_update(c);
+}
+
+// Runs on the incoming thread right after a switch, once the outgoing
+// thread's registers are saved: only now may another hart run it, or
+// its stack be reused if it exited
+static void finish_switch(void) {
+    struct cpu *c = this_cpu();
+    struct thread *prev = c->switch_prev;
+    c->switch_prev = NULL;
+
+    mb();
+    if (prev->state == THREAD_ZOMBIE) {
+        // Under pool_lock, so a racing thread_detach either sees on_cpu
+        // clear and frees the slot itself, or set detached before we look
+        ticket_lock(&pool_lock);
+        prev->on_cpu = 0;
+        int detached = prev->detached;
+        if (detached) prev->state = THREAD_UNUSED;
+        ticket_unlock(&pool_lock);
+        if (!detached) wake_all(&exit_wait);
+    } else {
+        prev->on_cpu = 0;
+    }
+    slice_update(c);
+}
+
+// Switch to the next ready thread on this hart, or its idle thread.
+// Call with interrupts disabled. A running caller is put back on the
+// queue; a blocked or exiting one is not, nor is a deadline thread out
+// of budget. Returns when the caller is next scheduled, possibly on
+// another hart. Every pass starts a fresh slice.
+static void schedule(void) {
+    struct cpu *c = this_cpu();
+    struct runqueue *rq = &runqs[c->id];
+    struct thread *prev = c->current;
+    uint64_t now = clock_now();
+
+    c->need_resched = 0;
+    timer_cancel(&slice_timers[c->id]);
+    account(prev, now);
+    if (prev->policy == SCHED_DEADLINE && prev->dl_left <= 0 &&
+        prev->state == THREAD_RUNNING) {
+        prev->state = THREAD_THROTTLED;
+        uint64_t wait = prev->dl_period_end > now ? prev->dl_period_end - now : 0;
+        timer_start(&prev->dl_timer, clock_to_ms(wait) + 1);
+    }
+
+    spin_lock(&rq->lock);
+    if (prev->state == THREAD_RUNNING && prev != c->idle) rq_push(rq, prev);
+    struct thread *next = rq_pop(rq, 0);
+    spin_unlock(&rq->lock);
+
+    if (!next) next = c->idle;
+    next->state = THREAD_RUNNING;
+    if (next == prev) {
+        slice_update(c);
+        return;
+    }
+
+    next->on_cpu = 1;
+    next->exec_start = now;
+    next->switches++;
+    if (next->cpu != c->id) next->migrations++;
+    next->cpu = c->id;
+    c->current = next;
+    c->switch_prev = prev;
+    c->nr_switches++;
+    fpu_switch(prev, next);
+    switch_context(&prev->ctx, &next->ctx);
+    finish_switch();
+}
+
+// Body of every idle thread; interrupts are off at the top of the loop
+static void idle_loop(void) __attribute__((noreturn));
+static void idle_loop(void) {
+    struct cpu *c = this_cpu();     // Idle threads never migrate
+
+    for (;;) {
+        intr_off();
+        if (runqs[c->id].nr || steal(c->id)) {
+            schedule();
+        } else {
+            // Advertise before the final check so a kick cannot be missed
+            atomic_fetch_or64(&idle_mask, 1UL << c->id);
+            int work = 0;
+            for (unsigned int i = 0; i < MAX_HARTS; i++)
+                if (runqs[i].nr) work = 1;
+            if (!work) cpu_idle();
+            atomic_fetch_and64(&idle_mask, ~(1UL << c->id));
+        }
+        intr_on();
+    }
+}
+
+// First code a new thread runs, entered from switch_context's ret
+static void thread_start(void) {
+    finish_switch();
+    intr_on();
+    struct thread *t = thread_current();
+    thread_exit(t->fn(t->arg));
+}
+
+static void idle_start(void) {
+    finish_switch();
+    idle_loop();
+}
+
+struct thread *thread_current(void) {
+    return this_cpu()->current;
+}
+
+int thread_runnable(void) {
+    struct cpu *c = this_cpu();
+    return c->current && runqs[c->id].nr;
+}
+
+void thread_yield(void) {
+    if (!this_cpu()->current) return;
+    uint64_t s = intr_save();
+    schedule();
+    intr_restore(s);
+}
+
+// Not from a nested interrupt, a softirq (its per-hart state would be
+// left behind) or the idle thread
+void thread_preempt(void) {
+    struct cpu *c = this_cpu();
+    if (!c->need_resched || c->irq_depth || c->in_softirq || c->preempt_count) return;
+    if (!c->current || c->current == c->idle) {
+        c->need_resched = 0;
+        return;
+    }
+    schedule();
+}
+
+void thread_kick(struct thread *t) {
+    mb();                       // Publish the wake condition first
+    unsigned int cpu = t->cpu;
+    if (cpu != this_cpu()->id) ipi_send(cpu, IPI_WAKEUP);
+}
+
+int thread_can_sleep(void) {
+    struct cpu *c = this_cpu();
+    return c->current && c->current != c->idle &&
+           !c->irq_depth && !c->in_softirq && !c->preempt_count;
+}
+
+// A kill racing with the sleep either sees BLOCKED and wakes us, or we
+// see it here and skip one sleep (2 = seen, so later waits sleep normally)
+void thread_sleep(spinlock_t *l) {
+    struct thread *t = thread_current();
+    t->state = THREAD_BLOCKED;
+    mb();
+    if (t->killed == 1 && atomic_cmpxchg32((volatile uint32_t *)&t->state, THREAD_BLOCKED,
+                                      THREAD_RUNNING) == THREAD_BLOCKED) {
+        t->killed = 2;
+        spin_unlock(l);
+        return;
+    }
+    spin_unlock(l);
+    schedule();
+}
+
+// The wake may land before the sleeper has switched away: it is queued
+// while still on_cpu, and rq_pop leaves it alone until finish_switch
+void thread_wake(struct thread *t) {
+    if (atomic_cmpxchg32((volatile uint32_t *)&t->state, THREAD_BLOCKED,
+                         THREAD_RUNNABLE) != THREAD_BLOCKED) {
+        thread_kick(t);
+        return;
+    }
+
+    uint64_t s = intr_save();
+    struct cpu *c = this_cpu();
+    unsigned int cpu = t->cpu;
+    spin_lock(&runqs[cpu].lock);
+    rq_push(&runqs[cpu], t);
+    spin_unlock(&runqs[cpu].lock);
+
+    // If the target hart is busy, an idle one may steal the thread
+    if (cpu == c->id) {
+        if (c->current != c->idle) {
+            if (sched_before(t, c->current)) c->need_resched = 1;
+            slice_update(c);
+            kick_idle(cpu);
+        }
+    } else {
+        ipi_send(cpu, IPI_RESCHED);
+        if (!(idle_mask & (1UL << cpu))) kick_idle(cpu);
+    }
+    intr_restore(s);
+}
+
+// IPI_RESCHED: a thread was woken onto this hart's queue, or a class
+// changed. Preempt for a better thread; trap_irq's exit switches.
+static void resched_ipi(void) {
+    struct cpu *c = this_cpu();
+    struct thread *cur = c->current;
+    if (!cur || cur == c->idle) return;
+
+    spin_lock(&runqs[c->id].lock);
+    struct thread *best = rq_best(&runqs[c->id], 0);
+    spin_unlock(&runqs[c->id].lock);
+    if (best && sched_before(best, cur)) c->need_resched = 1;
+    slice_update(c);
+}
+
+void thread_resched(void) {
+    uint64_t s = intr_save();
+    thread_preempt();
+    intr_restore(s);
+}
+
+void thread_set_timeslice(uint64_t ms) {
+    timeslice_ms = ms ? ms : 1;
+}
+
+uint64_t thread_get_timeslice(void) {
+    return timeslice_ms;
+}
+
+//--------------------------------------------------
+//                   LIFECYCLE
+//--------------------------------------------------
+
+// Make the calling context this hart's thread t
+static void adopt(struct thread *t, const char *name) {
+    struct cpu *c = this_cpu();
+    set_name(t, name);
+    t->state = THREAD_RUNNING;
+    t->on_cpu = 1;
+    t->cpu = c->id;
+    t->exec_start = clock_now();
+    fpu_reset(&t->fpu);
+    c->current = t;
+    timer_setup(&slice_timers[c->id], slice_expired, NULL);
+}
+
+void thread_init(void) {
+    struct cpu *c = this_cpu();
+
+    lock_stats_register(&pool_lock_stats);
+    ipi_register(IPI_RESCHED, resched_ipi);
+    for (int i = 0; i < MAX_THREADS; i++)
+        timer_setup(&threads[i].dl_timer, dl_unthrottle, &threads[i]);
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        runq_stats[i].name = runq_names[i];
+        runqs[i].lock.stats = &runq_stats[i];
+        lock_stats_register(&runq_stats[i]);
+    }
+
+    threads[0].tid = 0;
+    adopt(&threads[0], "main");
+
+    struct thread *idle = &idle_threads[c->id];
+    set_name(idle, "idle0");
+    idle->tid = -1;
+    idle->cpu = c->id;
+    idle->stack = idle_stack0;
+    idle->ctx.ra = (uint64_t)idle_start;
+    idle->ctx.sp = (uint64_t)(idle_stack0 + THREAD_STACK_SIZE);
+    c->idle = idle;
+}
+
+void thread_idle_hart(void) {
+    struct cpu *c = this_cpu();
+    struct thread *idle = &idle_threads[c->id];
+    char name[] = "idle0";
+    name[4] = '0' + c->id;
+
+    idle->tid = -1;
+    adopt(idle, name);
+    c->idle = idle;
+    idle_loop();
+}
+
+// Queue a new thread on hart cpu (logical id, online)
+static int spawn(const char *name, thread_fn_t fn, void *arg, int pinned, unsigned int cpu) {
+    uint64_t s = ticket_lock_irqsave(&pool_lock);
+
+    struct thread *t = NULL;
+    int slot;
+    for (slot = 1; slot < MAX_THREADS; slot++) {
+        if (threads[slot].state == THREAD_UNUSED) {
+            t = &threads[slot];
+            break;
+        }
+    }
+    if (!t) {
+        ticket_unlock_irqrestore(&pool_lock, s);
+        return -1;
+    }
+
+    set_name(t, name);
+    t->tid = next_tid++;
+    t->state = THREAD_RUNNABLE;     // Claim the slot before dropping the lock
+    ticket_unlock(&pool_lock);
+
+    struct cpu *c = this_cpu();
+    t->fn = fn;
+    t->arg = arg;
+    t->exit_code = 0;
+    t->detached = 0;
+    t->pinned = pinned;
+    t->killed = 0;
+    t->exec_depth = 0;
+    t->out = NULL;
+    // Inherit the creator's directories, like fork
+    if (c->current) {
+        t->fs = c->current->fs;
+    } else {
+        t->fs.cwd = NULL;
+        t->fs.root = NULL;
+    }
+    // And its class, but a deadline reservation is not handed down
+    t->policy = SCHED_FAIR;
+    t->nice = 0;
+    t->prio = 0;
+    if (c->current && c->current->policy != SCHED_DEADLINE) {
+        t->policy = c->current->policy;
+        t->nice = c->current->nice;
+        t->prio = c->current->prio;
+    }
+    t->on_cpu = 0;
+    t->cpu = cpu;
+    t->switches = 0;
+    t->migrations = 0;
+    t->runtime = 0;
+    fpu_reset(&t->fpu);
+    t->stack = thread_stacks[slot];
+    t->ctx.ra = (uint64_t)thread_start;
+    t->ctx.sp = (uint64_t)(t->stack + THREAD_STACK_SIZE);
+
+    spin_lock(&runqs[cpu].lock);
+    rq_push(&runqs[cpu], t);
+    spin_unlock(&runqs[cpu].lock);
+
+    // Someone is now waiting behind the running thread (never ahead of
+    // it: the new thread's class is at most the creator's)
+    if (cpu != c->id) {
+        ipi_send(cpu, IPI_RESCHED);
+    } else if (c->current != c->idle) {
+        slice_update(c);
+        if (!pinned) kick_idle(c->id);
+    }
+
+    int tid = t->tid;
+    intr_restore(s);
+    return tid;
+}
+
+int thread_create(const char *name, thread_fn_t fn, void *arg) {
+    return spawn(name, fn, arg, 0, this_cpu()->id);
+}
+
+int thread_create_on(const char *name, thread_fn_t fn, void *arg, unsigned int cpu) {
+    if (cpu >= MAX_HARTS || !cpus[cpu].online) return -1;
+    return spawn(name, fn, arg, 1, cpu);
+}
+
+void thread_exit(int code) {
+    intr_off();
+    struct thread *t = thread_current();
+    t->exit_code = code;
+    if (t->policy == SCHED_DEADLINE) {
+        ticket_lock(&pool_lock);
+        dl_bw_total -= dl_bw(t);
+        t->policy = SCHED_FAIR;
+        ticket_unlock(&pool_lock);
+    }
+    t->state = THREAD_ZOMBIE;
+    schedule();
+    panic("thread_exit: zombie was scheduled");
+}
+
+int thread_join(int tid, int *code) {
+    struct thread *t = thread_find(tid);
+    struct thread *self = thread_current();
+    if (!t || t->detached || t == self) return -1;
+
+    // Zombie and off its hart: the stack is no longer in use
+    wait_event(&exit_wait, t->state == THREAD_ZOMBIE && !t->on_cpu);
+    if (code) *code = t->exit_code;
+    uint64_t s = ticket_lock_irqsave(&pool_lock);
+    t->state = THREAD_UNUSED;
+    ticket_unlock_irqrestore(&pool_lock, s);
+    return 0;
+}
+
+int thread_detach(int tid) {
+    uint64_t s = ticket_lock_irqsave(&pool_lock);
+    struct thread *t = thread_find(tid);
+    int ret = -1;
+    if (t && !t->detached) {
+        t->detached = 1;
+        if (t->state == THREAD_ZOMBIE && !t->on_cpu) t->state = THREAD_UNUSED;
+        ret = 0;
+    }
+    ticket_unlock_irqrestore(&pool_lock, s);
+    return ret;
+}
+
+int thread_done(int tid) {
+    struct thread *t = thread_find(tid);
+    if (!t) return -1;
+    return t->state == THREAD_ZOMBIE && !t->on_cpu;
+}
+
+int thread_kill(int tid) {
+    struct thread *t = thread_find(tid);
+    if (!t || tid <= 0 || t->state == THREAD_ZOMBIE) return -1;
+    t->killed = 1;
+    mb();                       // Pairs with thread_sleep
+    thread_wake(t);
+    return 0;
+}
+
+int thread_killed(void) {
+    struct thread *t = thread_current();
+    return t && t->killed;
+}
+
+int thread_setsched(int tid, const struct sched_attr *a) {
+    switch (a->policy) {
+    case SCHED_FAIR:
+        if (a->nice < NICE_MIN || a->nice > NICE_MAX) return -1;
+        break;
+    case SCHED_FIFO:
+        if (a->prio < RT_PRIO_MIN || a->prio > RT_PRIO_MAX) return -1;
+        break;
+    case SCHED_DEADLINE:
+        if (a->runtime_ms == 0 || a->runtime_ms > a->deadline_ms ||
+            a->deadline_ms > a->period_ms)
+            return -1;
+        break;
+    default:
+        return -1;
+    }
+
+    uint64_t s = ticket_lock_irqsave(&pool_lock);
+    struct thread *t = thread_find(tid);
+    if (!t || t->tid < 0 || t->state == THREAD_ZOMBIE) {
+        ticket_unlock_irqrestore(&pool_lock, s);
+        return -1;
+    }
+
+    uint64_t old_bw = t->policy == SCHED_DEADLINE ? dl_bw(t) : 0;
+    uint64_t new_bw = 0;
+    if (a->policy == SCHED_DEADLINE) {
+        new_bw = a->runtime_ms * 1024 / a->period_ms;
+        uint64_t max = (uint64_t)cpu_count() * 1024 * DL_BW_MAX_PCT / 100;
+        if (dl_bw_total - old_bw + new_bw > max) {
+            ticket_unlock_irqrestore(&pool_lock, s);
+            return -2;
+        }
+        t->dl_runtime = ms_to_ticks(a->runtime_ms);
+        t->dl_deadline = ms_to_ticks(a->deadline_ms);
+        t->dl_period = ms_to_ticks(a->period_ms);
+        t->dl_period_end = 0;
+        dl_replenish(t, clock_now());
+    }
+    dl_bw_total = dl_bw_total - old_bw + new_bw;
+    t->nice = a->policy == SCHED_FAIR ? a->nice : 0;
+    t->prio = a->policy == SCHED_FIFO ? a->prio : 0;
+    t->policy = a->policy;
+    ticket_unlock(&pool_lock);
+
+    // Let t's hart re-pick: t may now beat, or lose to, what it competes with
+    unsigned int cpu = t->cpu;
+    if (cpu == this_cpu()->id) this_cpu()->need_resched = 1;
+    else ipi_send(cpu, IPI_RESCHED);
+    intr_restore(s);
+    thread_resched();
+    return 0;
+}
+
+int thread_getsched(int tid, struct sched_attr *a) {
+    struct thread *t = thread_find(tid);
+    if (!t || t->tid < 0) return -1;
+    a->policy = t->policy;
+    a->nice = t->nice;
+    a->prio = t->prio;
+    a->runtime_ms = a->deadline_ms = a->period_ms = 0;
+    if (t->policy == SCHED_DEADLINE) {
+        a->runtime_ms = clock_to_ms(t->dl_runtime);
+        a->deadline_ms = clock_to_ms(t->dl_deadline);
+        a->period_ms = clock_to_ms(t->dl_period);
+    }
+    return 0;
+}
+
+//--------------------------------------------------
+//                SHELL COMMANDS
+//--------------------------------------------------
+
+// Class and its parameter: fair/<nice>, fifo/<prio>, dl/<runtime ms>
+static void print_sched(struct thread *t) {
+    if (t->policy == SCHED_DEADLINE) {
+        uart_puts("dl/");
+        uart_putdec(clock_to_ms(t->dl_runtime));
+    } else if (t->policy == SCHED_FIFO) {
+        uart_puts("fifo/");
+        uart_putdec(t->prio);
+    } else {
+        uart_puts("fair/");
+        if (t->nice < 0) uart_puts("-");
+        uart_putdec(t->nice < 0 ? -t->nice : t->nice);
+    }
+}
+
+void thread_print(void) {
+    uart_puts("TID  STATE    HART  SCHED    SWITCHES  MIGRATIONS  NAME\n");
+    for (int i = 0; i < MAX_THREADS; i++) {
+        struct thread *t = &threads[i];
+        if (t->state == THREAD_UNUSED) continue;
+        uart_putdec(t->tid);
+        uart_puts("    ");
+        uart_puts(state_names[t->state]);
+        uart_puts("    ");
+        uart_putdec(cpus[t->cpu].hartid);
+        uart_puts("     ");
+        print_sched(t);
+        uart_puts("  ");
+        uart_putdec(t->switches);
+        uart_puts("  ");
+        uart_putdec(t->migrations);
+        uart_puts("  ");
+        uart_puts(t->name);
+        uart_puts("\n");
+    }
+
+    uart_puts("Timeslice: ");
+    uart_putdec(timeslice_ms);
+    uart_puts(" ms; ready per hart:");
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (!cpus[i].online) continue;
+        uart_puts(" ");
+        uart_putdec(runqs[i].nr);
+    }
+    uart_puts("\n");
+}
+
+// Runtime of t including its current run, if it is on a hart now
+static uint64_t runtime_now(struct thread *t, uint64_t now) {
+    uint64_t r = t->runtime;
+    if (t->on_cpu && t->state == THREAD_RUNNING && now > t->exec_start)
+        r += now - t->exec_start;
+    return r;
+}
+
+static void put_pct(uint64_t part, uint64_t whole) {
+    uint64_t pct = whole ? part * 100 / whole : 0;
+    if (pct > 100) pct = 100;
+    if (pct < 10) uart_puts("  ");
+    else if (pct < 100) uart_puts(" ");
+    uart_putdec(pct);
+    uart_puts("%");
+}
+
+// Previous top frame, to turn totals into rates
+static uint64_t top_time;
+static uint64_t top_idle[MAX_HARTS];
+static uint64_t top_switches[MAX_HARTS];
+static int top_tid[MAX_THREADS];
+static uint64_t top_runtime[MAX_THREADS];
+
+// Readings are racy snapshots of other harts' counters, good enough
+// for a monitor. Idle time is the idle thread's runtime, so a hart
+// asleep in wfi for the whole interval still reads 0% busy.
+void thread_top(void) {
+    uint64_t now = clock_now();
+    uint64_t span = now - top_time;
+    top_time = now;
+
+    uart_puts("HART  BUSY  READY  SWITCHES\n");
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        struct cpu *c = &cpus[i];
+        if (!c->online) continue;
+        uint64_t idle = runtime_now(&idle_threads[i], now);
+        uint64_t sw = c->nr_switches;
+        uint64_t idle_span = idle - top_idle[i];
+        if (idle_span > span) idle_span = span;
+
+        uart_putdec(c->hartid);
+        uart_puts("    ");
+        put_pct(span - idle_span, span);
+        uart_puts("  ");
+        uart_putdec(runqs[i].nr);
+        uart_puts("      ");
+        uart_putdec(sw - top_switches[i]);
+        uart_puts("\n");
+        top_idle[i] = idle;
+        top_switches[i] = sw;
+    }
+
+    // Runtime over the interval per slot; a reused slot starts from zero
+    uint64_t delta[MAX_THREADS];
+    int order[MAX_THREADS];
+    int n = 0;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        struct thread *t = &threads[i];
+        if (t->state == THREAD_UNUSED) {
+            top_tid[i] = -1;
+            continue;
+        }
+        uint64_t r = runtime_now(t, now);
+        delta[i] = top_tid[i] == t->tid && r >= top_runtime[i] ? r - top_runtime[i] : r;
+        top_tid[i] = t->tid;
+        top_runtime[i] = r;
+        order[n++] = i;
+    }
+    for (int i = 1; i < n; i++) {
+        int k = order[i], j = i;
+        for (; j > 0 && delta[order[j - 1]] < delta[k]; j--) order[j] = order[j - 1];
+        order[j] = k;
+    }
+
+    uart_puts("\nTID  HART  STATE      SCHED    CPU   TIME(ms)  SWITCHES  MIGRATIONS  NAME\n");
+    for (int i = 0; i < n; i++) {
+        struct thread *t = &threads[order[i]];
+        uart_putdec(t->tid);
+        uart_puts("    ");
+        uart_putdec(cpus[t->cpu].hartid);
+        uart_puts("     ");
+        uart_puts(state_names[t->state]);
+        uart_puts("  ");
+        print_sched(t);
+        uart_puts("  ");
+        put_pct(delta[order[i]], span);
+        uart_puts("  ");
+        uart_putdec(clock_to_ms(top_runtime[order[i]]));
+        uart_puts("  ");
+        uart_putdec(t->switches);
+        uart_puts("  ");
+        uart_putdec(t->migrations);
+        uart_puts("  ");
+        uart_puts(t->name);
+        uart_puts("\n");
+    }
+}
+
+#define BENCH_ROUNDS 10000
+
+static volatile int bench_stop;
+
+static int bench_thread(void *arg) {
+    (void)arg;
+    while (!bench_stop) thread_yield();
+    return 0;
+}
+
+// Ping-pong yields between the shell and a partner thread, both pinned
+// so an idle hart cannot steal either one mid-run
+void thread_bench(void) {
+    struct thread *self = thread_current();
+    int was_pinned = self->pinned;
+
+    bench_stop = 0;
+    self->pinned = 1;
+    int tid = spawn("bench", bench_thread, NULL, 1, this_cpu()->id);
+    if (tid < 0) {
+        self->pinned = was_pinned;
+        uart_puts("switchbench: no free thread slot\n");
+        return;
+    }
+    thread_yield();             // Let the partner reach its loop
+
+    uint64_t start = clock_now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) thread_yield();
+    uint64_t elapsed = clock_now() - start;
+
+    bench_stop = 1;
+    self->pinned = was_pinned;
+    thread_join(tid, NULL);
+
+    // Each round is two switches: to the partner and back
+    uart_puts("Context switch: ");
+    uart_putdec(elapsed / (2 * BENCH_ROUNDS));
+    uart_puts(" ticks (");
+    uart_putdec(clock_to_ns(elapsed) / (2 * BENCH_ROUNDS));
+    uart_puts(" ns) per yield\n");
+}
@@ -0,0 +1,193 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#define MAX_THREADS         24      // Includes one worker per hart (work.c)
+#define THREAD_STACK_SIZE   16384
+#define THREAD_NAME_LEN     16
+#define TIMESLICE_MS        10      // Default; changed with the timeslice command
+
+// struct context layout, shared with switch.S
+#define CTX_RA    0
+#define CTX_SP    8
+#define CTX_S0    16
+#define CTX_SIZE  112
+
+#ifndef __ASSEMBLER__
+
+#include "stdint.h"
+#include "lock.h"
+#include "timer.h"
+#include "fpu.h"
+#include "fs.h"
+
+struct outbuf;
+
+// Callee-saved state of a switched-out thread
+struct context {
+    uint64_t ra;
+    uint64_t sp;
+    uint64_t s[12];             // s0-s11
+};
+
+_Static_assert(sizeof(struct context) == CTX_SIZE, "switch.S assumes this layout");
+
+enum thread_state {
+    THREAD_UNUSED = 0,
+    THREAD_RUNNABLE,            // On the run queue
+    THREAD_RUNNING,
+    THREAD_BLOCKED,             // Sleeping on a wait queue, off the run queue
+    THREAD_ZOMBIE,              // Exited, waiting to be joined
+    THREAD_THROTTLED,           // Deadline budget used up until the period ends
+};
+
+// Scheduling classes, in the order they are served: a ready deadline
+// thread runs before any FIFO thread, which runs before any fair one
+enum sched_policy {
+    SCHED_FAIR = 0,             // Round robin, slice scaled by nice
+    SCHED_FIFO,                 // Fixed priority, no slice
+    SCHED_DEADLINE,             // Earliest deadline first, budget per period
+};
+
+#define NICE_MIN        -20
+#define NICE_MAX        19
+#define RT_PRIO_MIN     1
+#define RT_PRIO_MAX     99
+#define DL_BW_MAX_PCT   95      // Deadline share of each hart, at most
+
+struct sched_attr {
+    enum sched_policy policy;
+    int nice;                   // SCHED_FAIR
+    int prio;                   // SCHED_FIFO: higher runs first
+    uint64_t runtime_ms;        // SCHED_DEADLINE: CPU time per period,
+    uint64_t deadline_ms;       // to be used within this of each activation,
+    uint64_t period_ms;         // activations at least this far apart
+};
+
+typedef int (*thread_fn_t)(void *arg);
+
+struct thread {
+    struct context ctx;
+    int tid;
+    enum thread_state state;
+    char name[THREAD_NAME_LEN];
+    thread_fn_t fn;
+    void *arg;
+    int exit_code;
+    int detached;               // Reap on exit instead of waiting for join
+    volatile int killed;        // thread_kill called (2: noticed by thread_sleep)
+    int exec_depth;             // Nesting of shell exec scripts
+    struct outbuf *out;         // Output capture (io.c), NULL for the UART
+    struct fs_context fs;       // Working directory and root (fs.c)
+    struct fpu_state fpu;       // Saved FP/vector registers (fpu.c)
+    uint8_t *stack;             // Base of the stack slot (NULL for adopted contexts)
+    struct thread *next;        // Run queue link
+
+    unsigned int cpu;           // Hart it is running on / last ran on
+    volatile int on_cpu;        // Context still live on a hart: not stealable
+    int pinned;                 // Never stolen: stays on cpu
+    uint64_t switches;          // Times switched in
+    uint64_t migrations;        // Times switched in on a different hart
+    uint64_t runtime;           // Clock ticks spent running
+    uint64_t exec_start;        // Clock value when last switched in
+
+    enum sched_policy policy;
+    int nice;
+    int prio;
+    uint64_t dl_runtime;        // Deadline parameters, in clock ticks
+    uint64_t dl_deadline;
+    uint64_t dl_period;
+    uint64_t dl_abs_deadline;   // Of the current activation
+    uint64_t dl_period_end;     // Budget is replenished from here on
+    int64_t dl_left;            // Budget left in this period
+    struct timer dl_timer;      // Releases a throttled thread
+};
+
+// Adopt the running boot context as thread 0 ("main") and create the boot
+// hart's idle thread
+void thread_init(void);
+
+// Secondary harts: adopt the boot context as this hart's idle thread and
+// run the idle loop (picks up local work, steals from busy harts)
+void thread_idle_hart(void) __attribute__((noreturn));
+
+// Start fn(arg) on a new thread; returns its tid, -1 if the pool is full
+int thread_create(const char *name, thread_fn_t fn, void *arg);
+
+// Same, pinned to the hart with logical id cpu; -1 if it is offline
+int thread_create_on(const char *name, thread_fn_t fn, void *arg, unsigned int cpu);
+
+// End the calling thread; code is handed to thread_join
+void thread_exit(int code) __attribute__((noreturn));
+
+// Wait for tid to exit and free its slot. Returns 0 and stores the
+// exit code (if code is non-NULL), or -1 if tid is not joinable.
+int thread_join(int tid, int *code);
+
+// Let the thread be reaped on exit without a join
+int thread_detach(int tid);
+
+// 1 once tid has exited, so thread_join will not block; -1 if no such thread
+int thread_done(int tid);
+
+// Ask tid to stop: sets its killed flag and wakes it if blocked. Killing
+// is cooperative; long-running code polls thread_killed at safe points.
+// Returns -1 for an unknown, exited or boot thread.
+int thread_kill(int tid);
+int thread_killed(void);
+
+// Give up the hart to the next runnable thread, if there is one
+void thread_yield(void);
+
+// Interrupt exit: switch away if the timeslice ran out (called by trap_irq)
+void thread_preempt(void);
+
+// Kick the hart t is on out of wfi so a waiting thread re-checks its
+// condition (call after making the condition true)
+void thread_kick(struct thread *t);
+
+// 1 if the caller may sleep: a thread other than idle, outside
+// interrupt and softirq context, with preemption enabled
+int thread_can_sleep(void);
+
+// Mark the calling thread blocked, drop l and switch away until
+// thread_wake. Call with interrupts disabled and l held; wait.c's wait
+// queues are the usual way in.
+void thread_sleep(spinlock_t *l);
+
+// Put a blocked thread back on the run queue of the hart it last ran
+// on; for any other state, just kick that hart
+void thread_wake(struct thread *t);
+
+// Change tid's scheduling class (tid 0 is the boot thread). Returns -1
+// for an unknown thread or out-of-range attributes, -2 if a deadline
+// reservation does not fit in the harts' remaining bandwidth.
+int thread_setsched(int tid, const struct sched_attr *attr);
+int thread_getsched(int tid, struct sched_attr *attr);
+
+// Switch away now if a wake left a better thread ready on this hart.
+// Thread context, no spinlocks held.
+void thread_resched(void);
+
+// Timeslice for round-robin preemption between ready threads
+void thread_set_timeslice(uint64_t ms);
+uint64_t thread_get_timeslice(void);
+
+// 1 if another thread is waiting to run on this hart
+int thread_runnable(void);
+
+// Thread running on this hart (NULL before thread_init)
+struct thread *thread_current(void);
+
+// threads command
+void thread_print(void);
+
+// top command: per-hart utilization and per-thread CPU use since the
+// previous call (or boot), busiest first
+void thread_top(void);
+
+// Measure a yield round trip between two threads (switchbench command)
+void thread_bench(void);
+
+#endif // __ASSEMBLER__
+
+#endif
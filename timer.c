@@ -0,0 +1,415 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "trap.h"
+#include "sbi.h"
+#include "cpu.h"
+#include "io.h"
+#include "clock.h"
+#include "softirq.h"
+#include "latency.h"
+#include "thread.h"
+#include "wait.h"
+#include "lock.h"
+#include "timer.h"
+
+//--------------------------------------------------
+//              HIERARCHICAL TIMER WHEEL
+//--------------------------------------------------
+// Each hart owns a wheel of WHEEL_LEVELS levels with 64 buckets each.
+// Level n has a granularity of 8^n ticks, so level 0 is exact to 1 ms
+// and each higher level covers 8x the range at 8x coarser resolution.
+//
+// Timers are never cascaded between levels: a timer is placed once, on
+// the level whose range covers its delta, with its deadline rounded UP to
+// that level's granularity. Far-off timeouts therefore coalesce into a
+// shared bucket (and a single hardware interrupt), insert and cancel are
+// O(1) list operations, and finding the next deadline is one bitmap scan
+// per level. There is no periodic tick: the hardware timer is programmed
+// for the earliest non-empty bucket only.
+//
+// A timer is always added to the calling hart's wheel, but may be
+// re-armed or cancelled from another hart, so each wheel has a lock.
+// Due timers move to the wheel's expired list and are run one at a time
+// with the lock dropped; until its callback starts a timer can still be
+// cancelled. The same timer must not be added from two harts at once.
+
+#define WHEEL_BITS     6
+#define WHEEL_SIZE     (1 << WHEEL_BITS)
+#define WHEEL_MASK     (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS   8
+#define LVL_CLK_SHIFT  3
+#define LVL_SHIFT(n)   ((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)    (1UL << LVL_SHIFT(n))
+// First delta that no longer fits in level n-1
+#define LVL_START(n)   ((uint64_t)(WHEEL_SIZE - 1) << LVL_SHIFT((n) - 1))
+#define WHEEL_MAX_DELTA (LVL_START(WHEEL_LEVELS) - 1)   // ~36 hours
+
+#define TIMER_NONE     ((uint64_t)-1)
+
+// Pseudo-bucket holding timers that are due but not yet run
+#define EXPIRED_IDX    (WHEEL_LEVELS * WHEEL_SIZE)
+
+struct timer_base {
+    spinlock_t lock;            // Everything below, and the timers' links
+    uint64_t clk;               // Next tick not yet processed
+    uint64_t programmed;        // Tick currently armed in hardware
+    uint64_t pending_map[WHEEL_LEVELS];   // Non-empty buckets per level
+    struct timer *buckets[WHEEL_LEVELS * WHEEL_SIZE + 1];   // + expired list
+};
+
+static struct timer_base bases[MAX_HARTS];
+
+static uint64_t time_per_tick;          // Clock ticks per wheel tick
+
+static inline struct timer_base *this_base(void) {
+    return &bases[this_cpu()->id];
+}
+
+// Count trailing zeros (x != 0); rv64gc has no ctz instruction and
+// the kernel does not link libgcc
+static unsigned int ctz64(uint64_t x) {
+    unsigned int n = 0;
+    if (!(x & 0xffffffffUL)) { n += 32; x >>= 32; }
+    if (!(x & 0xffff))       { n += 16; x >>= 16; }
+    if (!(x & 0xff))         { n += 8;  x >>= 8; }
+    if (!(x & 0xf))          { n += 4;  x >>= 4; }
+    if (!(x & 0x3))          { n += 2;  x >>= 2; }
+    if (!(x & 0x1))          { n += 1; }
+    return n;
+}
+
+//--------------------------------------------------
+//                 BUCKET HELPERS
+//--------------------------------------------------
+
+// Pick level + bucket for a deadline; *bucket_time is when it will fire
+static int calc_bucket(uint64_t clk, uint64_t expires, uint64_t *bucket_time) {
+    uint64_t delta = expires - clk;
+    unsigned int lvl = 0;
+
+    while (lvl < WHEEL_LEVELS - 1 && delta >= LVL_START(lvl + 1)) lvl++;
+
+    uint64_t e = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+    *bucket_time = e << LVL_SHIFT(lvl);
+    return lvl * WHEEL_SIZE + (e & WHEEL_MASK);
+}
+
+static void bucket_insert(struct timer_base *b, struct timer *t, int idx) {
+    struct timer *head = b->buckets[idx];
+    t->prev = NULL;
+    t->next = head;
+    if (head) head->prev = t;
+    b->buckets[idx] = t;
+    if (idx != EXPIRED_IDX)
+        b->pending_map[idx / WHEEL_SIZE] |= 1UL << (idx % WHEEL_SIZE);
+    t->idx = idx;
+    t->base = b;
+}
+
+static void bucket_remove(struct timer_base *b, struct timer *t) {
+    int idx = t->idx;
+    if (t->prev) t->prev->next = t->next;
+    else b->buckets[idx] = t->next;
+    if (t->next) t->next->prev = t->prev;
+    if (!b->buckets[idx] && idx != EXPIRED_IDX)
+        b->pending_map[idx / WHEEL_SIZE] &= ~(1UL << (idx % WHEEL_SIZE));
+    t->next = t->prev = NULL;
+    t->idx = -1;
+    t->base = NULL;
+}
+
+// Lock the wheel t is queued on and unlink it; returns 1 if it was
+// queued. t->base only changes under the lock of the wheel it names.
+static int timer_detach(struct timer *t) {
+    for (;;) {
+        struct timer_base *b = *(struct timer_base *volatile *)&t->base;
+        if (!b) return 0;
+        spin_lock(&b->lock);
+        if (t->base == b) {
+            bucket_remove(b, t);
+            spin_unlock(&b->lock);
+            return 1;
+        }
+        spin_unlock(&b->lock);  // Moved or ran meanwhile: look again
+    }
+}
+
+// Earliest tick at which some bucket fires, TIMER_NONE if the wheel is empty
+static uint64_t wheel_next(struct timer_base *b) {
+    uint64_t best = TIMER_NONE;
+
+    for (unsigned int lvl = 0; lvl < WHEEL_LEVELS; lvl++) {
+        uint64_t map = b->pending_map[lvl];
+        if (!map) continue;
+
+        // Level clock of the first aligned tick >= clk, then the first
+        // set bucket at or after that position (wrapping)
+        unsigned int shift = LVL_SHIFT(lvl);
+        uint64_t lclk = (b->clk + LVL_GRAN(lvl) - 1) >> shift;
+        unsigned int pos = lclk & WHEEL_MASK;
+        uint64_t rot = pos ? (map >> pos) | (map << (WHEEL_SIZE - pos)) : map;
+        uint64_t t = (lclk + ctz64(rot)) << shift;
+
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// Move every bucket that fires at tick clk onto the expired list
+static void wheel_collect(struct timer_base *b, uint64_t clk) {
+    for (unsigned int lvl = 0; lvl < WHEEL_LEVELS; lvl++) {
+        if (lvl > 0 && (clk & (LVL_GRAN(lvl) - 1))) break;
+
+        int idx = lvl * WHEEL_SIZE + ((clk >> LVL_SHIFT(lvl)) & WHEEL_MASK);
+        struct timer *t;
+        while ((t = b->buckets[idx])) {
+            bucket_remove(b, t);
+            bucket_insert(b, t, EXPIRED_IDX);
+        }
+    }
+}
+
+//--------------------------------------------------
+//               HARDWARE PROGRAMMING
+//--------------------------------------------------
+
+// Sstc lets S-mode write stimecmp directly instead of asking M-mode
+// firmware through an SBI ecall. Detected once at boot by probing the
+// CSR: without Sstc (or with menvcfg.STCE clear) the access is illegal.
+#define CSR_STIMECMP "0x14d"
+
+static int has_sstc = 0;
+
+static inline void stimecmp_write(uint64_t value) {
+    asm volatile("csrw " CSR_STIMECMP ", %0" :: "r"(value) : "memory");
+}
+
+static int sstc_probe(void) {
+    uint64_t v = 0;
+    trap_probe_begin();
+    asm volatile("csrr %0, " CSR_STIMECMP : "=r"(v) :: "memory");
+    return !trap_probe_end();
+}
+
+static void timer_set_deadline(uint64_t tick) {
+    uint64_t when = (tick == TIMER_NONE) ? TIMER_NONE : tick * time_per_tick;
+    if (has_sstc) stimecmp_write(when);
+    else sbi_set_timer(when);
+}
+
+// Run every timer whose bucket is due at or before now. Called and
+// returns with b->lock held; drops it around each callback.
+static void wheel_run(struct timer_base *b, uint64_t now) {
+    for (;;) {
+        uint64_t next = wheel_next(b);
+        if (next > now) break;
+
+        // Advance clk before callbacks so re-armed timers land ahead of it
+        wheel_collect(b, next);
+        b->clk = next + 1;
+
+        struct timer *t;
+        while ((t = b->buckets[EXPIRED_IDX])) {
+            bucket_remove(b, t);
+            spin_unlock(&b->lock);
+            t->fn(t, t->arg);
+            spin_lock(&b->lock);
+        }
+    }
+    if (b->clk <= now) b->clk = now + 1;
+}
+
+// Bottom half: run expired timers, then arm the next deadline
+static void timer_softirq(void) {
+    uint64_t s = intr_save();
+    struct timer_base *b = this_base();
+    spin_lock(&b->lock);
+    wheel_run(b, timer_ticks());
+
+    uint64_t next = wheel_next(b);
+    if (next != b->programmed) {
+        b->programmed = next;
+        timer_set_deadline(next);
+    }
+    spin_unlock(&b->lock);
+    intr_restore(s);
+}
+
+// Supervisor timer interrupt: the armed deadline has been consumed.
+// Disarm (clearing STIP) and leave the wheel walk to the softirq.
+static void timer_irq(struct trap_frame *tf) {
+    (void)tf;
+    struct timer_base *b = this_base();
+    uint64_t entry = this_cpu()->irq_entry;
+    uint64_t deadline = b->programmed * time_per_tick;
+    if (b->programmed != TIMER_NONE)
+        latency_record(LAT_TIMER, entry > deadline ? entry - deadline : 0);
+
+    b->programmed = TIMER_NONE;
+    timer_set_deadline(TIMER_NONE);
+    softirq_raise(SOFTIRQ_TIMER);
+}
+
+//--------------------------------------------------
+//                   PUBLIC API
+//--------------------------------------------------
+
+uint64_t timer_ticks(void) {
+    return clock_now() / time_per_tick;
+}
+
+void timer_setup(struct timer *t, timer_fn_t fn, void *arg) {
+    t->next = t->prev = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->arg = arg;
+    t->idx = -1;
+    t->base = NULL;
+}
+
+int timer_pending(struct timer *t) {
+    return t->idx >= 0;
+}
+
+// (Re)arm a timer for an absolute tick on the calling hart's wheel
+void timer_add(struct timer *t, uint64_t expires) {
+    uint64_t s = intr_save();
+    struct timer_base *b = this_base();
+
+    timer_detach(t);
+    spin_lock(&b->lock);
+
+    // clk only advances when the softirq runs, so after a long idle it
+    // lags far behind: catch it up (nothing is due before now) so the
+    // bucket granularity matches the real delay
+    uint64_t now = timer_ticks();
+    if (b->clk < now && wheel_next(b) > now) b->clk = now;
+
+    if (expires < b->clk) expires = b->clk;
+    if (expires - b->clk > WHEEL_MAX_DELTA) expires = b->clk + WHEEL_MAX_DELTA;
+    t->expires = expires;
+
+    uint64_t fire;
+    bucket_insert(b, t, calc_bucket(b->clk, expires, &fire));
+    if (fire < b->programmed) {
+        b->programmed = fire;
+        timer_set_deadline(fire);
+    }
+
+    spin_unlock(&b->lock);
+    intr_restore(s);
+}
+
+void timer_start(struct timer *t, uint64_t delay_ms) {
+    timer_add(t, timer_ticks() + delay_ms * TIMER_HZ / 1000);
+}
+
+// Cancel a pending timer from any hart; returns 1 if it was still
+// queued. Its callback may already be running on the wheel's hart.
+// The hardware deadline is left alone: an early spurious interrupt is
+// cheaper than rescanning the wheel on every cancel.
+int timer_cancel(struct timer *t) {
+    uint64_t s = intr_save();
+    int was_pending = timer_detach(t);
+    intr_restore(s);
+    return was_pending;
+}
+
+struct sleeper {
+    volatile uint64_t woken;    // Clock value at wake-up, 0 while asleep
+    struct waitqueue wait;
+};
+
+// The sleeper lives on the sleeping thread's stack: set woken under the
+// queue lock, so the thread cannot see it and return before we are done
+static void sleep_wake(struct timer *t, void *arg) {
+    (void)t;
+    struct sleeper *sl = arg;
+    uint64_t s = spin_lock_irqsave(&sl->wait.lock);
+    sl->woken = clock_now() | 1;
+    wake_one_locked(&sl->wait);
+    spin_unlock_irqrestore(&sl->wait.lock, s);
+}
+
+// A killed thread returns early. It stays pinned while asleep so it
+// wakes on the hart whose wheel holds the timer: its cancel then cannot
+// race with sleep_wake still using sl on another hart.
+void timer_sleep(uint64_t ms) {
+    struct sleeper sl = { 0, WAITQUEUE_INIT };
+    struct timer t;
+    struct thread *self = thread_current();
+    int was_pinned = self ? self->pinned : 0;
+
+    if (self) self->pinned = 1;
+    timer_setup(&t, sleep_wake, &sl);
+    // +1 tick: we may be partway through the current one
+    timer_add(&t, timer_ticks() + ms * TIMER_HZ / 1000 + 1);
+
+    wait_event(&sl.wait, sl.woken || thread_killed());
+    if (sl.woken) latency_since(LAT_WAKEUP, sl.woken);
+    else timer_cancel(&t);
+    if (self) self->pinned = was_pinned;
+}
+
+//--------------------------------------------------
+//              RE-ARM MICROBENCHMARK
+//--------------------------------------------------
+
+#define BENCH_ROUNDS 1000
+
+// Average cost of one deadline write, in timebase ticks
+static uint64_t bench_rearm(int use_sstc, uint64_t far) {
+    uint64_t start = clock_now();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        if (use_sstc) stimecmp_write(far + i);
+        else sbi_set_timer(far + i);
+    }
+    return (clock_now() - start) / BENCH_ROUNDS;
+}
+
+static void bench_report(const char *name, uint64_t cost) {
+    uart_puts(name);
+    uart_putdec(cost);
+    uart_puts(" ticks (");
+    uart_putdec(clock_to_ns(cost));
+    uart_puts(" ns) per re-arm\n");
+}
+
+// Compare SBI ecall vs direct stimecmp re-arm latency
+void timer_bench(void) {
+    uint64_t s = intr_save();
+    uint64_t far = clock_now() + clock_hz() * 3600; // Never fires during the run
+
+    uart_puts("Timer mode: ");
+    uart_puts(has_sstc ? "Sstc (stimecmp)\n" : "SBI set_timer\n");
+
+    bench_report("  SBI set_timer:  ", bench_rearm(0, far));
+    if (has_sstc) bench_report("  Sstc stimecmp:  ", bench_rearm(1, far));
+    else uart_puts("  Sstc stimecmp:  not available\n");
+
+    // Restore the real deadline
+    struct timer_base *b = this_base();
+    timer_set_deadline(b->programmed);
+    intr_restore(s);
+}
+
+//--------------------------------------------------
+//                     SETUP
+//--------------------------------------------------
+
+// Per-hart: start the wheel at the current tick with nothing armed
+void timer_init_hart(void) {
+    struct timer_base *b = this_base();
+    b->clk = timer_ticks();
+    b->programmed = TIMER_NONE;
+    timer_set_deadline(TIMER_NONE);
+    csr_set(sie, SIE_STIE);
+}
+
+void timer_init(void) {
+    time_per_tick = clock_hz() / TIMER_HZ;
+    has_sstc = sstc_probe();
+    trap_set_interrupt_handler(IRQ_S_TIMER, timer_irq);
+    softirq_register(SOFTIRQ_TIMER, timer_softirq);
+    timer_init_hart();
+}
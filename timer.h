@@ -0,0 +1,44 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "stdint.h"
+
+// Wheel resolution: one tick per millisecond
+#define TIMER_HZ 1000
+
+struct timer;
+struct timer_base;
+typedef void (*timer_fn_t)(struct timer *t, void *arg);
+
+// Caller-owned timer; embed it anywhere, the wheel only links it.
+struct timer {
+    struct timer *next;
+    struct timer *prev;
+    uint64_t expires;           // Absolute deadline in ticks
+    timer_fn_t fn;
+    void *arg;
+    int idx;                    // Wheel bucket, -1 when not pending
+    struct timer_base *base;    // Hart wheel the timer is queued on
+};
+
+// Setup (boot hart: timer_init; every hart: timer_init_hart)
+void timer_init(void);
+void timer_init_hart(void);
+
+// Current time in wheel ticks (ms since boot)
+uint64_t timer_ticks(void);
+
+// Timer management; O(1) insert and cancel
+void timer_setup(struct timer *t, timer_fn_t fn, void *arg);
+void timer_add(struct timer *t, uint64_t expires);
+void timer_start(struct timer *t, uint64_t delay_ms);
+int  timer_cancel(struct timer *t);
+int  timer_pending(struct timer *t);
+
+// Block the calling hart for at least ms milliseconds
+void timer_sleep(uint64_t ms);
+
+// Print SBI vs Sstc re-arm latency
+void timer_bench(void);
+
+#endif
@@ -0,0 +1,167 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+#include "sbi.h"
+#include "cpu.h"
+#include "ipi.h"
+#include "spin.h"
+#include "tlb.h"
+
+//--------------------------------------------------
+//                BATCHED TLB SHOOTDOWN
+//--------------------------------------------------
+// Unmapping collects ranges in a tlb_batch; the flush then issues one
+// cross-hart request for the whole batch, sent only to harts in the
+// address space's cpumask and scoped to its ASID:
+//   - one range (or an overflowed batch) -> a single SBI RFENCE call
+//   - several ranges -> one IPI; each target walks the whole batch
+// The kernel does not enable paging yet; this is the API the VM code
+// will call once it does.
+
+// Past this many pages in one range, drop the whole ASID locally instead
+#define TLB_PAGE_FLUSH_MAX 32
+
+// In-flight request from one initiator; targets ack by decrementing pending
+struct tlb_request {
+    struct tlb_batch *batch;
+    volatile uint32_t pending;
+};
+
+// mailbox[target][initiator]: each initiator has at most one request out
+static struct tlb_request *volatile mailbox[MAX_HARTS][MAX_HARTS];
+
+static inline void sfence_vma_page(uint64_t va, uint64_t asid) {
+    asm volatile("sfence.vma %0, %1" :: "r"(va), "r"(asid) : "memory");
+}
+
+static inline void sfence_vma_asid(uint64_t asid) {
+    asm volatile("sfence.vma zero, %0" :: "r"(asid) : "memory");
+}
+
+static void local_flush(struct tlb_batch *b) {
+    uint64_t asid = b->mm->asid;
+
+    if (b->full) {
+        sfence_vma_asid(asid);
+        return;
+    }
+    for (unsigned int i = 0; i < b->nr; i++) {
+        uint64_t pages = b->ranges[i].size / PAGE_SIZE;
+        if (pages > TLB_PAGE_FLUSH_MAX) {
+            sfence_vma_asid(asid);
+            return;
+        }
+        for (uint64_t p = 0; p < pages; p++)
+            sfence_vma_page(b->ranges[i].start + p * PAGE_SIZE, asid);
+    }
+}
+
+// IPI_TLB_FLUSH: run every request posted to this hart
+static void tlb_ipi(void) {
+    unsigned int self = this_cpu()->id;
+
+    for (unsigned int src = 0; src < MAX_HARTS; src++) {
+        struct tlb_request *req = mailbox[self][src];
+        if (!req) continue;
+        mailbox[self][src] = NULL;
+        local_flush(req->batch);
+        atomic_fetch_add32(&req->pending, (uint32_t)-1);
+    }
+}
+
+static uint64_t to_hart_mask(uint64_t cpumask) {
+    uint64_t mask = 0;
+    for (unsigned int i = 0; i < MAX_HARTS; i++)
+        if (cpumask & (1UL << i)) mask |= 1UL << cpus[i].hartid;
+    return mask;
+}
+
+//--------------------------------------------------
+//                   PUBLIC API
+//--------------------------------------------------
+
+void mm_activate(struct mm *mm) {
+    atomic_fetch_or64(&mm->cpumask, 1UL << this_cpu()->id);
+}
+
+void tlb_batch_init(struct tlb_batch *b, struct mm *mm) {
+    b->mm = mm;
+    b->nr = 0;
+    b->full = 0;
+}
+
+// Add a range (rounded out to whole pages); contiguous ranges are merged
+void tlb_batch_add(struct tlb_batch *b, uint64_t start, uint64_t size) {
+    uint64_t end = (start + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    start &= ~(PAGE_SIZE - 1);
+    if (b->full || end <= start) return;
+
+    if (b->nr > 0) {
+        uint64_t *last_start = &b->ranges[b->nr - 1].start;
+        uint64_t *last_size = &b->ranges[b->nr - 1].size;
+        if (*last_start + *last_size == start) {
+            *last_size += end - start;
+            return;
+        }
+    }
+    if (b->nr == TLB_BATCH_MAX) {
+        b->full = 1;
+        return;
+    }
+    b->ranges[b->nr].start = start;
+    b->ranges[b->nr].size = end - start;
+    b->nr++;
+}
+
+void tlb_batch_flush(struct tlb_batch *b) {
+    if (b->nr == 0 && !b->full) return;
+
+    uint64_t s = intr_save();   // Stay on this hart while flushing
+    struct mm *mm = b->mm;
+    unsigned int self = this_cpu()->id;
+    uint64_t targets = mm->cpumask & cpu_online_mask() & ~(1UL << self);
+
+    if (mm->cpumask & (1UL << self)) local_flush(b);
+
+    if (targets && (b->full || b->nr == 1)) {
+        // One range: let firmware do it in a single call
+        uint64_t start = b->full ? 0 : b->ranges[0].start;
+        uint64_t size = b->full ? (uint64_t)-1 : b->ranges[0].size;
+        sbi_remote_sfence_vma_asid(to_hart_mask(targets), 0, start, size, mm->asid);
+    } else if (targets) {
+        // Several ranges: one IPI carrying the whole batch
+        struct tlb_request req;
+        req.batch = b;
+        req.pending = 0;
+        for (unsigned int i = 0; i < MAX_HARTS; i++) {
+            if (!(targets & (1UL << i))) continue;
+            req.pending++;
+            mailbox[i][self] = &req;
+        }
+        mb();
+        ipi_send_mask(targets, IPI_TLB_FLUSH);
+
+        // Keep servicing our own IPIs so two harts flushing each other
+        // cannot deadlock; an IPI arriving ends the wait step early
+        uint32_t left;
+        while ((left = req.pending) != 0) {
+            ipi_poll();
+            spin_pause32(&req.pending, left);
+        }
+    }
+
+    b->nr = 0;
+    b->full = 0;
+    intr_restore(s);
+}
+
+void tlb_flush_range(struct mm *mm, uint64_t start, uint64_t size) {
+    struct tlb_batch b;
+    tlb_batch_init(&b, mm);
+    tlb_batch_add(&b, start, size);
+    tlb_batch_flush(&b);
+}
+
+void tlb_init(void) {
+    ipi_register(IPI_TLB_FLUSH, tlb_ipi);
+}
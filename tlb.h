@@ -0,0 +1,39 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include "stdint.h"
+
+#define PAGE_SIZE       4096UL
+#define TLB_BATCH_MAX   16      // Ranges per batch before falling back to a full ASID flush
+
+// An address space as far as TLB maintenance is concerned
+struct mm {
+    uint64_t asid;
+    volatile uint64_t cpumask;  // Logical ids of harts that have run it
+};
+
+// Ranges collected while unmapping, flushed with one cross-hart request
+struct tlb_batch {
+    struct mm *mm;
+    unsigned int nr;
+    int full;                   // Overflowed: flush the whole ASID
+    struct {
+        uint64_t start;
+        uint64_t size;
+    } ranges[TLB_BATCH_MAX];
+};
+
+void tlb_init(void);
+
+// Record that the calling hart now runs mm (call when switching satp)
+void mm_activate(struct mm *mm);
+
+// Batched shootdown
+void tlb_batch_init(struct tlb_batch *b, struct mm *mm);
+void tlb_batch_add(struct tlb_batch *b, uint64_t start, uint64_t size);
+void tlb_batch_flush(struct tlb_batch *b);
+
+// Single-range convenience wrapper
+void tlb_flush_range(struct mm *mm, uint64_t start, uint64_t size);
+
+#endif
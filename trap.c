@@ -0,0 +1,225 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "trap.h"
+#include "io.h"
+#include "softirq.h"
+#include "cpu.h"
+#include "thread.h"
+#include "fpu.h"
+
+// Assembly entry points (trap.S)
+extern void trap_entry(void);
+extern void trap_vector_table(void);
+
+_Static_assert(sizeof(struct trap_frame) == TRAP_FRAME_SIZE, "trap.S frame layout");
+
+//--------------------------------------------------
+//               DISPATCH TABLES
+//--------------------------------------------------
+
+static trap_handler_t exception_handlers[TRAP_NR_EXCEPTIONS];
+static trap_handler_t interrupt_handlers[TRAP_NR_INTERRUPTS];
+
+static const char *exception_names[TRAP_NR_EXCEPTIONS] = {
+    "instruction address misaligned",
+    "instruction access fault",
+    "illegal instruction",
+    "breakpoint",
+    "load address misaligned",
+    "load access fault",
+    "store address misaligned",
+    "store access fault",
+    "ecall from U-mode",
+    "ecall from S-mode",
+    "reserved",
+    "reserved",
+    "instruction page fault",
+    "load page fault",
+    "reserved",
+    "store page fault",
+};
+
+void trap_set_exception_handler(unsigned int cause, trap_handler_t fn) {
+    if (cause < TRAP_NR_EXCEPTIONS) exception_handlers[cause] = fn;
+}
+
+void trap_set_interrupt_handler(unsigned int cause, trap_handler_t fn) {
+    if (cause < TRAP_NR_INTERRUPTS) interrupt_handlers[cause] = fn;
+}
+
+//--------------------------------------------------
+//                  PANIC / DUMP
+//--------------------------------------------------
+
+static void trap_dump(struct trap_frame *tf) {
+    uint64_t cause = tf->scause;
+
+    uart_puts("  scause: ");
+    uart_puthex(cause);
+    if (!(cause & SCAUSE_INTERRUPT) && cause < TRAP_NR_EXCEPTIONS) {
+        uart_puts(" (");
+        uart_puts(exception_names[cause]);
+        uart_puts(")");
+    }
+    uart_puts("\n  sepc:   ");
+    uart_puthex(tf->sepc);
+    uart_puts("\n  stval:  ");
+    uart_puthex(tf->stval);
+    uart_puts("\n  ra:     ");
+    uart_puthex(tf->ra);
+    uart_puts("\n  sp:     ");
+    uart_puthex(tf->sp);
+    uart_puts("\n");
+}
+
+static void halt(void) __attribute__((noreturn));
+static void halt(void) {
+    intr_off();
+    for (;;) wfi();
+}
+
+void panic(const char *msg) {
+    intr_off();
+    uart_force_sync();
+    uart_puts("\nKERNEL PANIC: ");
+    uart_puts(msg);
+    uart_puts("\n");
+    halt();
+}
+
+static void trap_fatal(struct trap_frame *tf, const char *what) {
+    intr_off();
+    uart_force_sync();
+    uart_puts("\nKERNEL PANIC: ");
+    uart_puts(what);
+    uart_puts("\n");
+    trap_dump(tf);
+    halt();
+}
+
+//--------------------------------------------------
+//            DEFAULT EXCEPTION HANDLERS
+//--------------------------------------------------
+
+// Page faults: nothing is mapped on demand yet, so any fault is fatal
+static void handle_page_fault(struct trap_frame *tf) {
+    trap_fatal(tf, "unhandled page fault");
+}
+
+// ecall from a (future) user task: no syscalls yet, return -1 (ENOSYS)
+static void handle_ecall(struct trap_frame *tf) {
+    tf->a0 = (uint64_t)-1;
+    tf->sepc += 4;
+}
+
+// ebreak: report and continue after the instruction
+static void handle_breakpoint(struct trap_frame *tf) {
+    uart_puts("Breakpoint at ");
+    uart_puthex(tf->sepc);
+    uart_puts("\n");
+
+    // c.ebreak is 2 bytes, ebreak is 4 (low bits 11 = 32-bit encoding)
+    uint16_t insn = *(volatile uint16_t *)tf->sepc;
+    tf->sepc += ((insn & 0x3) == 0x3) ? 4 : 2;
+}
+
+//--------------------------------------------------
+//              INSTRUCTION PROBING
+//--------------------------------------------------
+// Used at boot to detect optional extensions (e.g. Sstc) by trying the
+// instruction: a probe fault is swallowed instead of being fatal.
+
+static volatile int probe_armed = 0;
+static volatile int probe_trapped = 0;
+
+void trap_probe_begin(void) {
+    probe_trapped = 0;
+    probe_armed = 1;
+}
+
+int trap_probe_end(void) {
+    probe_armed = 0;
+    return probe_trapped;
+}
+
+static void handle_illegal_inst(struct trap_frame *tf) {
+    if (fpu_trap(tf)) return;   // First FP/vector use: retry with the unit on
+    if (!probe_armed) trap_fatal(tf, "illegal instruction");
+
+    // Probed instructions are always full 32-bit encodings
+    probe_trapped = 1;
+    tf->sepc += 4;
+}
+
+//--------------------------------------------------
+//                 TRAP DISPATCH
+//--------------------------------------------------
+
+// Interrupts: called directly by the vectored stubs with a known cause.
+// Bottom halves raised by the handler run before returning, then the
+// interrupted thread is preempted if its timeslice ran out.
+void trap_irq(struct trap_frame *tf, uint64_t cause) {
+    struct cpu *c = this_cpu();
+    c->irq_entry = rdtime();
+    c->irq_depth++;
+
+    trap_handler_t fn = (cause < TRAP_NR_INTERRUPTS) ? interrupt_handlers[cause] : NULL;
+    if (!fn) trap_fatal(tf, "unexpected interrupt");
+    fn(tf);
+
+    if (softirq_pending()) softirq_run();
+    c->irq_depth--;
+
+    // Last thing before the frame is restored: the thread may be switched
+    // out here and resumed later, possibly on another hart
+    if (c->need_resched) thread_preempt();
+}
+
+// Generic entry: decode scause and look up the handler
+void trap_dispatch(struct trap_frame *tf) {
+    uint64_t cause = tf->scause;
+
+    if (cause & SCAUSE_INTERRUPT) {
+        trap_irq(tf, cause & ~SCAUSE_INTERRUPT);
+        return;
+    }
+
+    trap_handler_t fn = (cause < TRAP_NR_EXCEPTIONS) ? exception_handlers[cause] : NULL;
+    if (!fn) trap_fatal(tf, "unhandled exception");
+    fn(tf);
+}
+
+//--------------------------------------------------
+//                     SETUP
+//--------------------------------------------------
+
+// Install the default handlers and this hart's trap vector, then enable
+// interrupts globally. Individual sources stay masked in sie until their
+// driver enables them.
+void trap_init(void) {
+    trap_set_exception_handler(EXC_ILLEGAL_INST, handle_illegal_inst);
+    trap_set_exception_handler(EXC_BREAKPOINT, handle_breakpoint);
+    trap_set_exception_handler(EXC_ECALL_U, handle_ecall);
+    trap_set_exception_handler(EXC_INST_PAGE_FAULT, handle_page_fault);
+    trap_set_exception_handler(EXC_LOAD_PAGE_FAULT, handle_page_fault);
+    trap_set_exception_handler(EXC_STORE_PAGE_FAULT, handle_page_fault);
+
+    trap_init_hart();
+}
+
+// Per-hart: point stvec at the shared vector and enable interrupts
+void trap_init_hart(void) {
+    csr_write(sie, 0);
+    csr_write(sscratch, 0);
+
+#if TRAP_VECTORED
+    // stvec MODE is WARL: fall back to direct mode if vectoring is refused
+    csr_write(stvec, (uint64_t)trap_vector_table | STVEC_MODE_VECTORED);
+    if ((csr_read(stvec) & 0x3) != STVEC_MODE_VECTORED)
+        csr_write(stvec, (uint64_t)trap_entry);
+#else
+    csr_write(stvec, (uint64_t)trap_entry);
+#endif
+
+    intr_on();
+}
@@ -0,0 +1,58 @@
+#ifndef TRAP_H
+#define TRAP_H
+
+// Size of the trap frame pushed by trap.S (kept 16-byte aligned)
+#define TRAP_FRAME_SIZE 288
+
+// 1 = vectored stvec (interrupts jump straight to their own stub),
+// 0 = single direct-mode entry that decodes scause in C
+#define TRAP_VECTORED 1
+
+#define TRAP_NR_EXCEPTIONS 16
+#define TRAP_NR_INTERRUPTS 16
+
+#ifndef __ASSEMBLER__
+
+#include "stdint.h"
+
+// Registers saved on trap entry, in x1..x31 order followed by the trap CSRs.
+// trap.S hard-codes these offsets: register xN lives at (N-1)*8.
+struct trap_frame {
+    uint64_t ra, sp, gp, tp;
+    uint64_t t0, t1, t2;
+    uint64_t s0, s1;
+    uint64_t a0, a1, a2, a3, a4, a5, a6, a7;
+    uint64_t s2, s3, s4, s5, s6, s7, s8, s9, s10, s11;
+    uint64_t t3, t4, t5, t6;
+    uint64_t sepc;
+    uint64_t sstatus;
+    uint64_t scause;
+    uint64_t stval;
+    uint64_t pad;               // keeps the frame 16-byte aligned
+};
+
+typedef void (*trap_handler_t)(struct trap_frame *tf);
+
+// Setup (boot hart: trap_init; secondary harts: trap_init_hart)
+void trap_init(void);
+void trap_init_hart(void);
+
+// Dispatch table registration (cause = scause without the interrupt bit)
+void trap_set_exception_handler(unsigned int cause, trap_handler_t fn);
+void trap_set_interrupt_handler(unsigned int cause, trap_handler_t fn);
+
+// Entry points called from trap.S
+void trap_dispatch(struct trap_frame *tf);
+void trap_irq(struct trap_frame *tf, uint64_t cause);
+
+// Feature probing: run a possibly-unsupported instruction between
+// trap_probe_begin/end; end returns 1 if it raised illegal-instruction
+void trap_probe_begin(void);
+int trap_probe_end(void);
+
+// Print trap state and halt this hart
+void panic(const char *msg) __attribute__((noreturn));
+
+#endif // __ASSEMBLER__
+
+#endif
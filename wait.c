@@ -0,0 +1,133 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "atomic.h"
+#include "lock.h"
+#include "spin.h"
+#include "cpu.h"
+#include "thread.h"
+#include "wait.h"
+
+//--------------------------------------------------
+//                  WAIT QUEUES
+//--------------------------------------------------
+
+void waitqueue_init(struct waitqueue *wq) {
+    wq->lock = (spinlock_t)SPINLOCK_INIT;
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+// Caller holds wq->lock
+static void wq_remove(struct waitqueue *wq, struct wait_entry *e) {
+    struct wait_entry *prev = NULL;
+    for (struct wait_entry *w = wq->head; w; prev = w, w = w->next) {
+        if (w != e) continue;
+        if (prev) prev->next = e->next;
+        else wq->head = e->next;
+        if (wq->tail == e) wq->tail = prev;
+        e->queued = 0;
+        return;
+    }
+}
+
+void wait_sleep_locked(struct waitqueue *wq, struct wait_entry *e) {
+    e->thread = thread_current();
+    e->next = NULL;
+    e->queued = 1;
+    if (wq->tail) wq->tail->next = e;
+    else wq->head = e;
+    wq->tail = e;
+
+    if (thread_can_sleep()) {
+        thread_sleep(&wq->lock);
+    } else {
+        spin_unlock(&wq->lock);
+        cpu_idle();
+    }
+
+    // Back for another reason than this queue's wake: take the entry out
+    if (e->queued) {
+        spin_lock(&wq->lock);
+        if (e->queued) wq_remove(wq, e);
+        spin_unlock(&wq->lock);
+    }
+}
+
+int wake_one_locked(struct waitqueue *wq) {
+    struct wait_entry *e = wq->head;
+    if (!e) return 0;
+    wq->head = e->next;
+    if (!wq->head) wq->tail = NULL;
+
+    // e may be gone once queued drops: read the thread first
+    struct thread *t = e->thread;
+    e->queued = 0;
+    if (t) thread_wake(t);
+    return 1;
+}
+
+// A woken thread that outranks the waker takes over its hart at once.
+// Only from a context that had interrupts on, so no spinlock is held.
+static void wake_resched(int n, uint64_t s) {
+    if (n && (s & SSTATUS_SIE)) thread_resched();
+}
+
+int wake_one(struct waitqueue *wq) {
+    uint64_t s = spin_lock_irqsave(&wq->lock);
+    int n = wake_one_locked(wq);
+    spin_unlock_irqrestore(&wq->lock, s);
+    wake_resched(n, s);
+    return n;
+}
+
+int wake_all(struct waitqueue *wq) {
+    uint64_t s = spin_lock_irqsave(&wq->lock);
+    int n = 0;
+    while (wake_one_locked(wq)) n++;
+    spin_unlock_irqrestore(&wq->lock, s);
+    wake_resched(n, s);
+    return n;
+}
+
+//--------------------------------------------------
+//                 SLEEPING MUTEX
+//--------------------------------------------------
+
+static int mutex_acquire(struct mutex *m) {
+    uint64_t self = (uint64_t)thread_current();
+    return m->owner == NULL &&
+           atomic_cmpxchg64((volatile uint64_t *)&m->owner, 0, self) == 0;
+}
+
+int mutex_trylock(struct mutex *m) {
+    if (!mutex_acquire(m)) return 0;
+    mb();
+    if (m->stats) lock_stat_acquired(m->stats, 0);
+    return 1;
+}
+
+void mutex_lock(struct mutex *m) {
+    uint64_t wait_start = 0;
+    if (!mutex_acquire(m)) {
+        wait_start = rdtime();
+        int got = 0;
+        // Spin only while the owner is on a hart and can make progress;
+        // pause rather than wrs, so an owner that goes to sleep is noticed
+        for (int i = 0; i < MUTEX_SPIN_MAX && !got; i++) {
+            struct thread *o = m->owner;
+            if (o && !(o->on_cpu && o->state == THREAD_RUNNING)) break;
+            cpu_relax();
+            got = mutex_acquire(m);
+        }
+        if (!got) wait_event(&m->wait, mutex_acquire(m));
+    }
+    mb();                       // Acquire: nothing moves above the wait
+    if (m->stats) lock_stat_acquired(m->stats, wait_start);
+}
+
+void mutex_unlock(struct mutex *m) {
+    if (m->stats) lock_stat_release(m->stats);
+    mb();
+    m->owner = NULL;
+    wake_one(&m->wait);
+}
@@ -0,0 +1,90 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include "stdint.h"
+#include "lock.h"
+
+struct thread;
+
+//--------------------------------------------------
+//                  WAIT QUEUES
+//--------------------------------------------------
+// A thread waiting for a condition leaves the run queue and sleeps
+// until a waker makes the condition true and wakes the queue, so its
+// hart runs other threads (or idles) meanwhile. The condition is
+// checked under the queue lock and wakers take the same lock, so a
+// wake-up between the check and the sleep cannot be lost.
+//
+// Contexts that cannot sleep (interrupts, softirqs, idle threads, boot
+// before threads) still queue, but wait in cpu_idle; a wake kicks their
+// hart instead.
+
+struct wait_entry {
+    struct thread *thread;
+    struct wait_entry *next;
+    int queued;                 // Cleared by the waker that dequeued it
+};
+
+struct waitqueue {
+    spinlock_t lock;
+    struct wait_entry *head;
+    struct wait_entry *tail;
+};
+
+#define WAITQUEUE_INIT { SPINLOCK_INIT, NULL, NULL }
+
+void waitqueue_init(struct waitqueue *wq);
+
+// Wake the oldest waiter / every waiter; return how many were woken
+int wake_one(struct waitqueue *wq);
+int wake_all(struct waitqueue *wq);
+
+// Same, with wq->lock already held: for waitqueues that live in the
+// waiter's stack frame, where the waker must be done with wq before
+// the waiter can see its condition and return
+int wake_one_locked(struct waitqueue *wq);
+
+// Used by wait_event: called with wq->lock held and interrupts off;
+// sleeps until woken and returns with the lock dropped
+void wait_sleep_locked(struct waitqueue *wq, struct wait_entry *e);
+
+// Sleep until cond is true. cond is evaluated with wq->lock held, so it
+// must not take that lock itself.
+#define wait_event(wq, cond) do {                               \
+        struct wait_entry __we;                                 \
+        for (;;) {                                              \
+            uint64_t __s = spin_lock_irqsave(&(wq)->lock);      \
+            if (cond) {                                         \
+                spin_unlock_irqrestore(&(wq)->lock, __s);       \
+                break;                                          \
+            }                                                   \
+            wait_sleep_locked((wq), &__we);                     \
+            intr_restore(__s);                                  \
+        }                                                       \
+    } while (0)
+
+//--------------------------------------------------
+//                 SLEEPING MUTEX
+//--------------------------------------------------
+// For long critical sections in thread context. A contender spins for a
+// while if the owner is running on another hart (it will likely release
+// soon, and a sleep/wake pair costs two switches), then sleeps on the
+// mutex's wait queue. Unlock hands no ownership over: the woken waiter
+// competes for it again, which keeps the fast path a single cmpxchg.
+
+#define MUTEX_SPIN_MAX 1000     // Back-off steps before sleeping
+
+struct mutex {
+    struct thread *volatile owner;
+    struct waitqueue wait;
+    struct lock_stats *stats;
+};
+
+#define MUTEX_INIT { NULL, WAITQUEUE_INIT, NULL }
+#define MUTEX_INIT_STATS(s) { NULL, WAITQUEUE_INIT, (s) }
+
+void mutex_lock(struct mutex *m);
+int mutex_trylock(struct mutex *m);     // 1 if taken
+void mutex_unlock(struct mutex *m);
+
+#endif
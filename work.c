@@ -0,0 +1,96 @@
+#include "stdint.h"
+#include "riscv.h"
+#include "cpu.h"
+#include "io.h"
+#include "wait.h"
+#include "thread.h"
+#include "work.h"
+
+//--------------------------------------------------
+//             PER-HART DEFERRED WORK QUEUE
+//--------------------------------------------------
+// Work too heavy for a softirq (printing, filesystem updates) is queued
+// here and run by the hart's worker thread ("kworker<n>"), pinned to
+// it, with its own stack, no output capture and the root directory, so
+// an item never runs on the stack or in the context of whatever thread
+// happened to be waiting. Items queued from an interrupt are appended
+// with interrupts off; the worker detaches the whole list at once so a
+// burst of items costs one critical section. Items queued before
+// work_start wait for the worker.
+
+static struct waitqueue work_wait[MAX_HARTS];
+static volatile int worker_up[MAX_HARTS];
+
+void work_init(struct work *w, work_fn_t fn, void *arg) {
+    w->next = NULL;
+    w->fn = fn;
+    w->arg = arg;
+    w->queued = 0;
+}
+
+int work_queue(struct work *w) {
+    uint64_t s = intr_save();
+    struct cpu *c = this_cpu();
+    int queued = 0;
+
+    if (!w->queued) {
+        w->queued = 1;
+        w->next = NULL;
+        if (c->work_tail) c->work_tail->next = w;
+        else c->work_head = w;
+        c->work_tail = w;
+        queued = 1;
+    }
+
+    // Interrupts are still off: the wake cannot switch us away
+    if (queued && worker_up[c->id]) wake_one(&work_wait[c->id]);
+    intr_restore(s);
+    return queued;
+}
+
+int work_pending(void) {
+    return this_cpu()->work_head != NULL;
+}
+
+void work_run(void) {
+    struct cpu *c = this_cpu();
+
+    struct work *w = c->work_head;
+    c->work_head = c->work_tail = NULL;
+
+    intr_on();
+    while (w) {
+        struct work *next = w->next;
+        w->queued = 0;          // May be re-queued by its own handler
+        w->fn(w);
+        w = next;
+    }
+    intr_off();
+}
+
+static int worker_main(void *arg) {
+    (void)arg;
+    struct cpu *c = this_cpu();     // Pinned: never moves
+    for (;;) {
+        wait_event(&work_wait[c->id], c->work_head != NULL);
+        uint64_t s = intr_save();
+        work_run();
+        intr_restore(s);
+    }
+    return 0;
+}
+
+void work_start(void) {
+    char name[] = "kworker0";
+    for (unsigned int i = 0; i < MAX_HARTS; i++) {
+        if (!cpus[i].online) continue;
+        waitqueue_init(&work_wait[i]);
+        name[7] = '0' + i;
+        if (thread_create_on(name, worker_main, NULL, i) < 0) {
+            uart_puts("work: no thread slot for a worker\n");
+            return;
+        }
+        mb();                   // Queue ready before work_queue may wake it
+        worker_up[i] = 1;
+    }
+}
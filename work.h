@@ -0,0 +1,29 @@
+#ifndef WORK_H
+#define WORK_H
+
+struct work;
+typedef void (*work_fn_t)(struct work *w);
+
+// Deferred work item; embed in the owner and recover it from w->arg
+struct work {
+    struct work *next;
+    work_fn_t fn;
+    void *arg;
+    int queued;
+};
+
+void work_init(struct work *w, work_fn_t fn, void *arg);
+
+// Queue on the calling hart; returns 0 if the item was already queued
+int work_queue(struct work *w);
+
+// Start a pinned worker thread on every online hart (after smp_init)
+void work_start(void);
+
+// Run everything queued on this hart as one batch with interrupts on.
+// Call with interrupts disabled; they are disabled again on return.
+// Only the hart's worker calls it.
+void work_run(void);
+int work_pending(void);
+
+#endif